@@ -5,106 +5,28 @@
 #include <glm/glm/gtc/matrix_transform.hpp>
 #include <fstream>
 #include <sstream>
+#include "geometry.h"
+#include "octree.h"
+#include "scene.h"
 
 float rotationX = 0.0f;
 float rotationY = 0.0f;
-float objectTranslationX = 0.0f;
-float objectTranslationY = 0.0f;
-float objectTranslationZ = 0.0f;
+int draggedInstance = -1;
 int lastMouseX, lastMouseY;
 bool isDragging = false;
 bool isObjectDragging = false;
 
-struct Triangle {
-    glm::vec3 normal;
-    glm::vec3 vertices[3];
-};
-
-struct AABB {
-    glm::vec3 min;
-    glm::vec3 max;
-};
-
 glm::vec3 cameraPos(1.0f, 0.0f, 0.0f);
 
+// display 에서 저장해 두고 클릭 위치를 world 광선으로 되돌릴 때 쓴다
+GLdouble modelviewMatrix[16];
+GLdouble projectionMatrix[16];
+GLint viewport[4];
 
-struct OctreeNode {
-    AABB box;
-    std::vector<Triangle> triangles;
-    OctreeNode* children[8] = { nullptr };
+Scene scene;
 
-    ~OctreeNode() {
-        for (int i = 0; i < 8; ++i) {
-            delete children[i];
-        }
-    }
-};
 void renderAABB(const AABB& box);
 
-int maxDepth = 3;
-
-glm::vec3 calculateCenter(const AABB& box) {
-    return (box.min + box.max) * 0.5f;
-}
-
-std::vector<AABB> splitAABB(const AABB& box) {
-    std::vector<AABB> children(8);
-    glm::vec3 center = calculateCenter(box);
-
-    for (int i = 0; i < 8; ++i) {
-        children[i].min = glm::vec3(
-            (i & 1) ? center.x : box.min.x,
-            (i & 2) ? center.y : box.min.y,
-            (i & 4) ? center.z : box.min.z
-        );
-
-        children[i].max = glm::vec3(
-            (i & 1) ? box.max.x : center.x,
-            (i & 2) ? box.max.y : center.y,
-            (i & 4) ? box.max.z : center.z
-        );
-    }
-    return children;
-}
-
-OctreeNode* buildOctree(const AABB& box, const std::vector<Triangle>& triangles, int depth) {
-    if (depth > maxDepth || triangles.empty()) {
-        return nullptr;
-    }
-
-    OctreeNode* node = new OctreeNode();
-    node->box = box;
-    node->triangles = triangles;
-
-    if (depth == maxDepth) {
-        return node;
-    }
-
-    std::vector<AABB> childrenAABBs = splitAABB(box);
-    for (int i = 0; i < 8; ++i) {
-        std::vector<Triangle> childTriangles;
-
-        for (const auto& tri : triangles) {
-            bool overlaps = false;
-            for (int j = 0; j < 3; ++j) {
-                if (tri.vertices[j].x >= childrenAABBs[i].min.x && tri.vertices[j].x <= childrenAABBs[i].max.x &&
-                    tri.vertices[j].y >= childrenAABBs[i].min.y && tri.vertices[j].y <= childrenAABBs[i].max.y &&
-                    tri.vertices[j].z >= childrenAABBs[i].min.z && tri.vertices[j].z <= childrenAABBs[i].max.z) {
-                    overlaps = true;
-                    break;
-                }
-            }
-            if (overlaps) {
-                childTriangles.push_back(tri);
-            }
-        }
-
-        node->children[i] = buildOctree(childrenAABBs[i], childTriangles, depth + 1);
-    }
-
-    return node;
-}
-
 void renderOctree(const OctreeNode* node) {
     if (!node) return;
 
@@ -115,25 +37,30 @@ void renderOctree(const OctreeNode* node) {
     }
 }
 
-void deleteOctree(OctreeNode* node) {
-    if (!node) return;
-
-    for (int i = 0; i < 8; ++i) {
-        deleteOctree(node->children[i]);
+int pickInstance(int x, int y) {
+    GLdouble nearX, nearY, nearZ, farX, farY, farZ;
+    GLdouble windowY = viewport[3] - y - 1;
+    if (!gluUnProject(x, windowY, 0.0, modelviewMatrix, projectionMatrix, viewport, &nearX, &nearY, &nearZ) ||
+        !gluUnProject(x, windowY, 1.0, modelviewMatrix, projectionMatrix, viewport, &farX, &farY, &farZ)) {
+        return -1;
     }
 
-    delete node;
+    glm::vec3 origin(nearX, nearY, nearZ);
+    glm::vec3 direction = glm::vec3(farX, farY, farZ) - origin;
+    return scene.pick(origin, direction, 1.0f);
 }
 
 void mouseButton(int button, int state, int x, int y) {
     if (button == GLUT_LEFT_BUTTON) {
         if (state == GLUT_DOWN) {
-            isObjectDragging = true;
+            draggedInstance = pickInstance(x, y);
+            isObjectDragging = draggedInstance >= 0;
             lastMouseX = x;
             lastMouseY = y;
         }
         else if (state == GLUT_UP) {
             isObjectDragging = false;
+            draggedInstance = -1;
         }
     }
     else if (button == GLUT_RIGHT_BUTTON) {
@@ -160,16 +87,18 @@ void mouseMotion(int x, int y) {
     else if (isObjectDragging) {
         float sensitivity = 0.01f;
 
-        glm::vec3 objectPos(objectTranslationX, objectTranslationY, objectTranslationZ);
+        glm::vec3 objectPos(scene.instances[draggedInstance].transform[3]);
 
         glm::vec3 forward = glm::normalize(objectPos - cameraPos);
         glm::vec3 worldUp(0.0f, 1.0f, 0.0f);
         glm::vec3 right = glm::normalize(glm::cross(worldUp, forward));
         glm::vec3 up = glm::normalize(glm::cross(forward, right));
 
-        objectTranslationX += (x - lastMouseX) * sensitivity * -right.x;
-        objectTranslationZ += (x - lastMouseX) * sensitivity * -right.z;
-        objectTranslationY += (y - lastMouseY) * sensitivity * -up.y;
+        glm::vec3 delta(
+            (x - lastMouseX) * sensitivity * -right.x,
+            (y - lastMouseY) * sensitivity * -up.y,
+            (x - lastMouseX) * sensitivity * -right.z);
+        scene.translateInstance(draggedInstance, delta);
 
         lastMouseX = x;
         lastMouseY = y;
@@ -178,22 +107,6 @@ void mouseMotion(int x, int y) {
     }
 }
 
-AABB calculateAABB(const std::vector<Triangle>& triangles) {
-    AABB box;
-    if (triangles.empty()) return box;
-
-    box.min = triangles[0].vertices[0];
-    box.max = triangles[0].vertices[0];
-
-    for (const auto& tri : triangles) {
-        for (int i = 0; i < 3; ++i) {
-            box.min = glm::min(box.min, tri.vertices[i]);
-            box.max = glm::max(box.max, tri.vertices[i]);
-        }
-    }
-    return box;
-}
-
 void renderAABB(const AABB& box) {
     glLineWidth(3.0f);
     glBegin(GL_LINES);
@@ -269,20 +182,6 @@ void renderSTL(const std::vector<Triangle>& triangles) {
     glEnd();
 }
 
-std::vector<Triangle> stlModel1;
-AABB modelAABB1;
-std::vector<Triangle> stlModel2;
-AABB modelAABB2;
-
-OctreeNode* octree1 = nullptr;
-OctreeNode* octree2 = nullptr;
-
-bool checkAABBCollision(const AABB& box1, const AABB& box2) {
-    return (box1.min.x <= box2.max.x && box1.max.x >= box2.min.x) &&
-        (box1.min.y <= box2.max.y && box1.max.y >= box2.min.y) &&
-        (box1.min.z <= box2.max.z && box1.max.z >= box2.min.z);
-}
-
 void renderAABBWithColor(const AABB& box, const glm::vec3& color) {
     glColor3f(color.r, color.g, color.b);
     renderAABB(box);
@@ -317,45 +216,68 @@ void display() {
     glRotatef(rotationX, 1.0f, 0.0f, 0.0f);
     glRotatef(rotationY, 0.0f, 1.0f, 0.0f);
 
-    glPushMatrix();
-    glColor3f(0.5f, 0.5f, 0.5f);
-    renderSTL(stlModel1);
-    renderOctree(octree1);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslatef(objectTranslationX, objectTranslationY, objectTranslationZ);
-    glColor3f(0.5f, 0.5f, 0.5f);
-    renderSTL(stlModel2);
+    glGetDoublev(GL_MODELVIEW_MATRIX, modelviewMatrix);
+    glGetDoublev(GL_PROJECTION_MATRIX, projectionMatrix);
+    glGetIntegerv(GL_VIEWPORT, viewport);
 
-    AABB movedAABB2 = modelAABB2;
-    movedAABB2.min += glm::vec3(objectTranslationX, objectTranslationY, objectTranslationZ);
-    movedAABB2.max += glm::vec3(objectTranslationX, objectTranslationY, objectTranslationZ);
+    for (const auto& instance : scene.instances) {
+        const Mesh& mesh = scene.meshes[instance.mesh];
 
-    renderOctree(octree2);
-    glPopMatrix();
+        glPushMatrix();
+        glMultMatrixf(&instance.transform[0][0]);
+        glColor3f(0.5f, 0.5f, 0.5f);
+        renderSTL(mesh.triangles);
+        renderOctree(mesh.octree);
+        glPopMatrix();
+    }
 
-    bool collision = checkAABBCollision(modelAABB1, movedAABB2);
+    scene.update();
+
+    std::vector<bool> collision(scene.instances.size(), false);
+    for (const auto& pair : scene.getCollidingPairs()) {
+        collision[pair.first] = true;
+        collision[pair.second] = true;
+
+        // 접촉점과 밀어낼 방향 (깊이만큼) 표시
+        ContactManifold manifold;
+        if (scene.computeContact(pair.first, pair.second, manifold)) {
+            glColor3f(1.0f, 1.0f, 0.0f);
+            glBegin(GL_LINES);
+            for (int i = 0; i < manifold.count; ++i) {
+                const ContactPoint& point = manifold.points[i];
+                glm::vec3 end = point.position + point.normal * point.depth;
+                glVertex3fv(&point.position[0]);
+                glVertex3fv(&end[0]);
+            }
+            glEnd();
+        }
 
-    if (collision)
-    {
-        glColor3f(1.0f, 0.0f, 0.0f);
-    }
-    else
-    {
-        glColor3f(1.0f, 1.0f, 1.0f);
+        // 충돌한 leaf cell 표시
+        const CollisionFront* front = scene.getCollisionFront(pair.first, pair.second);
+        for (const auto& nodes : front->getCollidingPairs()) {
+            glPushMatrix();
+            glMultMatrixf(&scene.instances[pair.first].transform[0][0]);
+            renderAABBWithColor(nodes.a->box, glm::vec3(1.0f, 0.0f, 0.0f));
+            glPopMatrix();
+
+            glPushMatrix();
+            glMultMatrixf(&scene.instances[pair.second].transform[0][0]);
+            renderAABBWithColor(nodes.b->box, glm::vec3(1.0f, 0.0f, 0.0f));
+            glPopMatrix();
+        }
     }
-    renderAABB(modelAABB1);
 
-    if (collision)
-    {
-        glColor3f(1.0f, 0.0f, 0.0f);
-    }
-    else
-    {
-        glColor3f(1.0f, 1.0f, 1.0f);
+    for (size_t i = 0; i < scene.instances.size(); ++i) {
+        if (collision[i])
+        {
+            glColor3f(1.0f, 0.0f, 0.0f);
+        }
+        else
+        {
+            glColor3f(1.0f, 1.0f, 1.0f);
+        }
+        renderAABB(scene.instances[i].worldBox);
     }
-    renderAABB(movedAABB2);
 
     glutSwapBuffers();
 }
@@ -411,20 +333,23 @@ void setupLighting() {
 
 int main(int argc, char** argv) {
     std::string filepath1 = "C:/Users/brian/OneDrive/바탕 화면/3d_bounding_box/cat.stl";
+    std::vector<Triangle> stlModel1;
     if (!loadSTL(filepath1, stlModel1)) {
         return -1;
     }
-    modelAABB1 = calculateAABB(stlModel1);
 
     std::string filepath2 = "C:/Users/brian/OneDrive/바탕 화면/3d_bounding_box/dog.stl";
+    std::vector<Triangle> stlModel2;
     if (!loadSTL(filepath2, stlModel2)) {
         return -1;
     }
-    modelAABB2 = calculateAABB(stlModel2);
 
-    // Octree 생성
-    octree1 = buildOctree(modelAABB1, stlModel1, 0);
-    octree2 = buildOctree(modelAABB2, stlModel2, 0);
+    // Scene 구성 (Octree 는 addMesh 에서 생성)
+    int mesh1 = scene.addMesh(stlModel1);
+    int mesh2 = scene.addMesh(stlModel2);
+    scene.addInstance(mesh1, glm::mat4(1.0f));
+    scene.addInstance(mesh2, glm::mat4(1.0f));
+    scene.broadPhase = BroadPhaseType::DynamicTree;
 
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
@@ -442,9 +367,5 @@ int main(int argc, char** argv) {
 
     glutMainLoop();
 
-    // Octree 삭제
-    deleteOctree(octree1);
-    deleteOctree(octree2);
-
     return 0;
 }
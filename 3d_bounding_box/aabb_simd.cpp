@@ -0,0 +1,206 @@
+﻿#include "aabb_simd.h"
+
+#include <limits>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define AABB_SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AABB_SIMD_SSE
+#endif
+
+namespace {
+
+const float emptyMin = std::numeric_limits<float>::max();
+const float emptyMax = -std::numeric_limits<float>::max();
+
+// 8개 box 를 query 와 비교해 8 bit mask 반환
+inline unsigned overlap8(const AABB& q,
+    const float* minX, const float* minY, const float* minZ,
+    const float* maxX, const float* maxY, const float* maxZ) {
+#if defined(AABB_SIMD_AVX)
+    __m256 r = _mm256_and_ps(
+        _mm256_cmp_ps(_mm256_loadu_ps(minX), _mm256_set1_ps(q.max.x), _CMP_LE_OQ),
+        _mm256_cmp_ps(_mm256_loadu_ps(maxX), _mm256_set1_ps(q.min.x), _CMP_GE_OQ));
+    r = _mm256_and_ps(r, _mm256_cmp_ps(_mm256_loadu_ps(minY), _mm256_set1_ps(q.max.y), _CMP_LE_OQ));
+    r = _mm256_and_ps(r, _mm256_cmp_ps(_mm256_loadu_ps(maxY), _mm256_set1_ps(q.min.y), _CMP_GE_OQ));
+    r = _mm256_and_ps(r, _mm256_cmp_ps(_mm256_loadu_ps(minZ), _mm256_set1_ps(q.max.z), _CMP_LE_OQ));
+    r = _mm256_and_ps(r, _mm256_cmp_ps(_mm256_loadu_ps(maxZ), _mm256_set1_ps(q.min.z), _CMP_GE_OQ));
+    return static_cast<unsigned>(_mm256_movemask_ps(r));
+#elif defined(AABB_SIMD_SSE)
+    unsigned result = 0;
+    for (int half = 0; half < 8; half += 4) {
+        __m128 r = _mm_and_ps(
+            _mm_cmple_ps(_mm_loadu_ps(minX + half), _mm_set1_ps(q.max.x)),
+            _mm_cmpge_ps(_mm_loadu_ps(maxX + half), _mm_set1_ps(q.min.x)));
+        r = _mm_and_ps(r, _mm_cmple_ps(_mm_loadu_ps(minY + half), _mm_set1_ps(q.max.y)));
+        r = _mm_and_ps(r, _mm_cmpge_ps(_mm_loadu_ps(maxY + half), _mm_set1_ps(q.min.y)));
+        r = _mm_and_ps(r, _mm_cmple_ps(_mm_loadu_ps(minZ + half), _mm_set1_ps(q.max.z)));
+        r = _mm_and_ps(r, _mm_cmpge_ps(_mm_loadu_ps(maxZ + half), _mm_set1_ps(q.min.z)));
+        result |= static_cast<unsigned>(_mm_movemask_ps(r)) << half;
+    }
+    return result;
+#else
+    unsigned result = 0;
+    for (int i = 0; i < 8; ++i) {
+        bool overlap = (minX[i] <= q.max.x) & (maxX[i] >= q.min.x) &
+            (minY[i] <= q.max.y) & (maxY[i] >= q.min.y) &
+            (minZ[i] <= q.max.z) & (maxZ[i] >= q.min.z);
+        result |= static_cast<unsigned>(overlap) << i;
+    }
+    return result;
+#endif
+}
+
+// a, b 의 같은 위치 box 8 쌍을 비교
+inline unsigned overlapPairs8(const AABBArray& a, const AABBArray& b, size_t offset) {
+#if defined(AABB_SIMD_AVX)
+    __m256 r = _mm256_and_ps(
+        _mm256_cmp_ps(_mm256_loadu_ps(&a.minX[offset]), _mm256_loadu_ps(&b.maxX[offset]), _CMP_LE_OQ),
+        _mm256_cmp_ps(_mm256_loadu_ps(&a.maxX[offset]), _mm256_loadu_ps(&b.minX[offset]), _CMP_GE_OQ));
+    r = _mm256_and_ps(r, _mm256_cmp_ps(_mm256_loadu_ps(&a.minY[offset]), _mm256_loadu_ps(&b.maxY[offset]), _CMP_LE_OQ));
+    r = _mm256_and_ps(r, _mm256_cmp_ps(_mm256_loadu_ps(&a.maxY[offset]), _mm256_loadu_ps(&b.minY[offset]), _CMP_GE_OQ));
+    r = _mm256_and_ps(r, _mm256_cmp_ps(_mm256_loadu_ps(&a.minZ[offset]), _mm256_loadu_ps(&b.maxZ[offset]), _CMP_LE_OQ));
+    r = _mm256_and_ps(r, _mm256_cmp_ps(_mm256_loadu_ps(&a.maxZ[offset]), _mm256_loadu_ps(&b.minZ[offset]), _CMP_GE_OQ));
+    return static_cast<unsigned>(_mm256_movemask_ps(r));
+#elif defined(AABB_SIMD_SSE)
+    unsigned result = 0;
+    for (size_t half = offset; half < offset + 8; half += 4) {
+        __m128 r = _mm_and_ps(
+            _mm_cmple_ps(_mm_loadu_ps(&a.minX[half]), _mm_loadu_ps(&b.maxX[half])),
+            _mm_cmpge_ps(_mm_loadu_ps(&a.maxX[half]), _mm_loadu_ps(&b.minX[half])));
+        r = _mm_and_ps(r, _mm_cmple_ps(_mm_loadu_ps(&a.minY[half]), _mm_loadu_ps(&b.maxY[half])));
+        r = _mm_and_ps(r, _mm_cmpge_ps(_mm_loadu_ps(&a.maxY[half]), _mm_loadu_ps(&b.minY[half])));
+        r = _mm_and_ps(r, _mm_cmple_ps(_mm_loadu_ps(&a.minZ[half]), _mm_loadu_ps(&b.maxZ[half])));
+        r = _mm_and_ps(r, _mm_cmpge_ps(_mm_loadu_ps(&a.maxZ[half]), _mm_loadu_ps(&b.minZ[half])));
+        result |= static_cast<unsigned>(_mm_movemask_ps(r)) << (half - offset);
+    }
+    return result;
+#else
+    unsigned result = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        size_t k = offset + i;
+        bool overlap = (a.minX[k] <= b.maxX[k]) & (a.maxX[k] >= b.minX[k]) &
+            (a.minY[k] <= b.maxY[k]) & (a.maxY[k] >= b.minY[k]) &
+            (a.minZ[k] <= b.maxZ[k]) & (a.maxZ[k] >= b.minZ[k]);
+        result |= static_cast<unsigned>(overlap) << i;
+    }
+    return result;
+#endif
+}
+
+// 채움 칸은 끝이 없는 query 와도 겹칠 수 있으므로 count 이후의 bit 를 지운다
+void clearPadding(std::vector<uint64_t>& mask, size_t count) {
+    if (count & 63) {
+        mask.back() &= (1ull << (count & 63)) - 1;
+    }
+}
+
+}
+
+void AABB8::clear() {
+    for (int i = 0; i < 8; ++i) {
+        minX[i] = minY[i] = minZ[i] = emptyMin;
+        maxX[i] = maxY[i] = maxZ[i] = emptyMax;
+    }
+}
+
+void AABB8::set(int i, const AABB& box) {
+    minX[i] = box.min.x;
+    minY[i] = box.min.y;
+    minZ[i] = box.min.z;
+    maxX[i] = box.max.x;
+    maxY[i] = box.max.y;
+    maxZ[i] = box.max.z;
+}
+
+void AABBArray::clear() {
+    count = 0;
+    minX.clear();
+    minY.clear();
+    minZ.clear();
+    maxX.clear();
+    maxY.clear();
+    maxZ.clear();
+}
+
+void AABBArray::resize(size_t size) {
+    size_t padded = (size + 7) & ~size_t(7);
+    minX.resize(padded, emptyMin);
+    minY.resize(padded, emptyMin);
+    minZ.resize(padded, emptyMin);
+    maxX.resize(padded, emptyMax);
+    maxY.resize(padded, emptyMax);
+    maxZ.resize(padded, emptyMax);
+
+    for (size_t i = size; i < padded; ++i) {
+        minX[i] = minY[i] = minZ[i] = emptyMin;
+        maxX[i] = maxY[i] = maxZ[i] = emptyMax;
+    }
+    count = size;
+}
+
+void AABBArray::push(const AABB& box) {
+    if (count == minX.size()) {
+        resize(count + 1);
+    }
+    else {
+        ++count;
+    }
+    set(count - 1, box);
+}
+
+void AABBArray::set(size_t i, const AABB& box) {
+    minX[i] = box.min.x;
+    minY[i] = box.min.y;
+    minZ[i] = box.min.z;
+    maxX[i] = box.max.x;
+    maxY[i] = box.max.y;
+    maxZ[i] = box.max.z;
+}
+
+AABB AABBArray::get(size_t i) const {
+    AABB box;
+    box.min = glm::vec3(minX[i], minY[i], minZ[i]);
+    box.max = glm::vec3(maxX[i], maxY[i], maxZ[i]);
+    return box;
+}
+
+void AABBArray::swapRemove(size_t i) {
+    size_t last = count - 1;
+    if (i != last) {
+        set(i, get(last));
+    }
+    minX[last] = minY[last] = minZ[last] = emptyMin;
+    maxX[last] = maxY[last] = maxZ[last] = emptyMax;
+    --count;
+}
+
+unsigned overlapMask8(const AABB& query, const AABB8& boxes) {
+    return overlap8(query, boxes.minX, boxes.minY, boxes.minZ, boxes.maxX, boxes.maxY, boxes.maxZ);
+}
+
+unsigned overlapMask8(const AABB& query, const AABBArray& boxes, size_t offset) {
+    return overlap8(query, &boxes.minX[offset], &boxes.minY[offset], &boxes.minZ[offset],
+        &boxes.maxX[offset], &boxes.maxY[offset], &boxes.maxZ[offset]);
+}
+
+void overlapMask(const AABB& query, const AABBArray& boxes, std::vector<uint64_t>& mask) {
+    mask.assign((boxes.count + 63) / 64, 0);
+    for (size_t offset = 0; offset < boxes.count; offset += 8) {
+        uint64_t bits = overlapMask8(query, boxes, offset);
+        mask[offset >> 6] |= bits << (offset & 63);
+    }
+    clearPadding(mask, boxes.count);
+}
+
+void overlapPairs(const AABBArray& a, const AABBArray& b, std::vector<uint64_t>& mask) {
+    size_t count = a.count < b.count ? a.count : b.count;
+    mask.assign((count + 63) / 64, 0);
+    for (size_t offset = 0; offset < count; offset += 8) {
+        uint64_t bits = overlapPairs8(a, b, offset);
+        mask[offset >> 6] |= bits << (offset & 63);
+    }
+    clearPadding(mask, count);
+}
@@ -0,0 +1,70 @@
+﻿#pragma once
+
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include <vector>
+#include "geometry.h"
+
+// box 8개를 축별로 나눠 담은 고정 크기 SoA. octree 자식 검사처럼 개수가 8 이하일 때 사용
+struct AABB8 {
+    float minX[8], minY[8], minZ[8];
+    float maxX[8], maxY[8], maxZ[8];
+
+    void clear();
+    void set(int i, const AABB& box);
+};
+
+// 가변 길이 SoA. 길이는 항상 8의 배수로 맞추고 남는 칸은 어떤 box 와도 겹치지 않는 빈 box 로 채운다
+struct AABBArray {
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+    size_t count = 0;
+
+    void clear();
+    void resize(size_t size);
+    void push(const AABB& box);
+    void set(size_t i, const AABB& box);
+    AABB get(size_t i) const;
+    void swapRemove(size_t i);
+};
+
+// query 와 겹치는 box 의 bit 를 1 로. AVX 가 있으면 반복당 8개, 없으면 SSE 로 4개씩 비교한다
+unsigned overlapMask8(const AABB& query, const AABB8& boxes);
+unsigned overlapMask8(const AABB& query, const AABBArray& boxes, size_t offset);
+void overlapMask(const AABB& query, const AABBArray& boxes, std::vector<uint64_t>& mask);
+
+// a[i] 와 b[i] 가 겹치면 bit i 를 1 로
+void overlapPairs(const AABBArray& a, const AABBArray& b, std::vector<uint64_t>& mask);
+
+// mask 의 가장 낮은 1 bit 위치 (word != 0)
+inline int lowestBit(uint64_t word) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return static_cast<int>(index);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanForward(&index, static_cast<unsigned long>(word))) return static_cast<int>(index);
+    _BitScanForward(&index, static_cast<unsigned long>(word >> 32));
+    return static_cast<int>(index) + 32;
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+// 1 bit 의 개수
+inline int countBits(uint64_t word) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    return static_cast<int>(__popcnt64(word));
+#elif defined(_MSC_VER)
+    return static_cast<int>(__popcnt(static_cast<unsigned>(word)) + __popcnt(static_cast<unsigned>(word >> 32)));
+#else
+    return __builtin_popcountll(word);
+#endif
+}
+
+inline bool testMaskBit(const std::vector<uint64_t>& mask, size_t i) {
+    return ((mask[i >> 6] >> (i & 63)) & 1) != 0;
+}
@@ -0,0 +1,132 @@
+﻿#include "closest_point.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "parallel.h"
+
+namespace {
+
+struct QueueEntry {
+    float distanceSq;
+    const OctreeNode* node;
+
+    // std::push_heap 은 max heap 이므로 거리가 작은 쪽이 위로 오도록 뒤집는다
+    bool operator<(const QueueEntry& other) const { return distanceSq > other.distanceSq; }
+};
+
+float distanceSqToAABB(const glm::vec3& p, const AABB& box) {
+    glm::vec3 d = glm::max(glm::max(box.min - p, p - box.max), glm::vec3(0.0f));
+    return glm::dot(d, d);
+}
+
+}
+
+// Ericson, Real-Time Collision Detection 5.1.5
+glm::vec3 closestPointOnTriangle(const glm::vec3& p, const glm::vec3 vertices[3]) {
+    const glm::vec3& a = vertices[0];
+    const glm::vec3& b = vertices[1];
+    const glm::vec3& c = vertices[2];
+
+    glm::vec3 ab = b - a;
+    glm::vec3 ac = c - a;
+    glm::vec3 ap = p - a;
+    float d1 = glm::dot(ab, ap);
+    float d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp);
+    float d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return b;
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp);
+    float d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return c;
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    float denom = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+ClosestPointResult closestPoint(const OctreeNode* tree, const glm::vec3& p, float maxDistance) {
+    ClosestPointResult result;
+    result.distance = maxDistance;
+    if (!tree) return result;
+
+    float bestSq = maxDistance < std::sqrt(std::numeric_limits<float>::max())
+        ? maxDistance * maxDistance : std::numeric_limits<float>::max();
+
+    // 질의마다 할당하지 않도록 스레드별 queue 를 재사용한다
+    thread_local std::vector<QueueEntry> queue;
+    queue.clear();
+    queue.push_back({ distanceSqToAABB(p, tree->bounds), tree });
+
+    while (!queue.empty()) {
+        std::pop_heap(queue.begin(), queue.end());
+        QueueEntry entry = queue.back();
+        queue.pop_back();
+        if (entry.distanceSq > bestSq) break;
+
+        const OctreeNode* node = entry.node;
+        if (node->isLeaf()) {
+            for (size_t i = 0; i < node->triangles.size(); ++i) {
+                // 삼각형 box 까지의 거리로 먼저 거른다
+                const glm::vec3* vertices = node->triangles[i].vertices;
+                AABB triangleBox;
+                triangleBox.min = glm::min(glm::min(vertices[0], vertices[1]), vertices[2]);
+                triangleBox.max = glm::max(glm::max(vertices[0], vertices[1]), vertices[2]);
+                if (distanceSqToAABB(p, triangleBox) >= bestSq) continue;
+
+                glm::vec3 q = closestPointOnTriangle(p, vertices);
+                glm::vec3 d = q - p;
+                float distanceSq = glm::dot(d, d);
+                if (distanceSq < bestSq) {
+                    bestSq = distanceSq;
+                    result.point = q;
+                    result.triangle = node->triangleIds[i];
+                }
+            }
+            continue;
+        }
+
+        for (int i = 0; i < 8; ++i) {
+            const OctreeNode* child = node->children[i];
+            if (!child) continue;
+            float distanceSq = distanceSqToAABB(p, child->bounds);
+            if (distanceSq <= bestSq) {
+                queue.push_back({ distanceSq, child });
+                std::push_heap(queue.begin(), queue.end());
+            }
+        }
+    }
+
+    if (result.triangle >= 0) {
+        result.distance = std::sqrt(bestSq);
+    }
+    return result;
+}
+
+void closestPoints(const OctreeNode* tree, const glm::vec3* points, size_t count, ClosestPointResult* results,
+    float maxDistance) {
+    parallelFor(count, 256, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; ++i) {
+            results[i] = closestPoint(tree, points[i], maxDistance);
+        }
+    });
+}
@@ -0,0 +1,24 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <glm/glm/glm.hpp>
+#include "octree.h"
+
+// triangle 은 buildOctree 에 넘긴 삼각형 번호, maxDistance 안에 삼각형이 없으면 -1
+struct ClosestPointResult {
+    glm::vec3 point = glm::vec3(0.0f);
+    int triangle = -1;
+    float distance = 0.0f;
+};
+
+glm::vec3 closestPointOnTriangle(const glm::vec3& p, const glm::vec3 vertices[3]);
+
+// 노드 bounds 까지의 거리가 작은 것부터 꺼내는 best-first 탐색.
+// 꺼낸 노드가 지금까지 찾은 거리보다 멀면 남은 노드도 모두 멀므로 끝낸다
+ClosestPointResult closestPoint(const OctreeNode* tree, const glm::vec3& p,
+    float maxDistance = std::numeric_limits<float>::max());
+
+// 점마다 closestPoint 를 스레드에 나눠 계산한다. results 는 count 개 이상이어야 한다
+void closestPoints(const OctreeNode* tree, const glm::vec3* points, size_t count, ClosestPointResult* results,
+    float maxDistance = std::numeric_limits<float>::max());
@@ -0,0 +1,430 @@
+﻿#include "collision.h"
+
+#include <cmath>
+#include <limits>
+#include <utility>
+#include "parallel.h"
+
+namespace {
+
+bool separatedOnAxis(const glm::vec3& axis, const glm::vec3 tri1[3], const glm::vec3 tri2[3]) {
+    if (glm::dot(axis, axis) < 1e-12f) return false;
+
+    float min1 = glm::dot(axis, tri1[0]);
+    float max1 = min1;
+    float min2 = glm::dot(axis, tri2[0]);
+    float max2 = min2;
+    for (int i = 1; i < 3; ++i) {
+        float p1 = glm::dot(axis, tri1[i]);
+        float p2 = glm::dot(axis, tri2[i]);
+        min1 = glm::min(min1, p1);
+        max1 = glm::max(max1, p1);
+        min2 = glm::min(min2, p2);
+        max2 = glm::max(max2, p2);
+    }
+    return max1 < min2 || max2 < min1;
+}
+
+AABB triangleAABB(const glm::vec3 tri[3]) {
+    AABB box;
+    box.min = glm::min(tri[0], glm::min(tri[1], tri[2]));
+    box.max = glm::max(tri[0], glm::max(tri[1], tri[2]));
+    return box;
+}
+
+bool boundsOverlap(const OctreeNode* a, const OctreeNode* b, const glm::mat4& bToA) {
+    return checkAABBCollision(a->bounds, transformAABB(b->bounds, bToA));
+}
+
+float boxVolume(const AABB& box) {
+    glm::vec3 d = box.max - box.min;
+    return d.x * d.y * d.z;
+}
+
+struct TraversalScratch {
+    std::vector<NodePair> stack;
+    std::vector<glm::vec3> transformedB;
+    AABBArray triangleBoxes;
+    std::vector<uint64_t> mask;
+};
+
+// 한쪽이 leaf 이면 다른 쪽을, 아니면 더 큰 쪽을 내려간다.
+// 자식 bounds 8개를 상대 노드 bounds 와 SIMD 로 한 번에 비교해 push(childA, childB, overlapping) 호출
+template <typename Push>
+void expandPair(const OctreeNode* a, const OctreeNode* b, const glm::mat4& bToA, Push push) {
+    bool descendA = !a->isLeaf() && (b->isLeaf() || boxVolume(a->bounds) >= boxVolume(b->bounds));
+    const OctreeNode* parent = descendA ? a : b;
+
+    AABB8 childBounds;
+    childBounds.clear();
+    for (int i = 0; i < 8; ++i) {
+        const OctreeNode* child = parent->children[i];
+        if (!child) continue;
+        childBounds.set(i, descendA ? child->bounds : transformAABB(child->bounds, bToA));
+    }
+
+    unsigned mask = descendA ? overlapMask8(transformAABB(b->bounds, bToA), childBounds)
+        : overlapMask8(a->bounds, childBounds);
+
+    for (int i = 0; i < 8; ++i) {
+        const OctreeNode* child = parent->children[i];
+        if (!child) continue;
+        bool overlapping = ((mask >> i) & 1) != 0;
+        if (descendA) {
+            push(child, b, overlapping);
+        }
+        else {
+            push(a, child, overlapping);
+        }
+    }
+}
+
+void transformTriangles(const OctreeNode* node, const glm::mat4& transform, std::vector<glm::vec3>& out) {
+    out.resize(node->triangles.size() * 3);
+    for (size_t i = 0; i < node->triangles.size(); ++i) {
+        for (int j = 0; j < 3; ++j) {
+            out[i * 3 + j] = glm::vec3(transform * glm::vec4(node->triangles[i].vertices[j], 1.0f));
+        }
+    }
+}
+
+// 삼각형 box 들을 SoA 로 채우고 전체를 감싸는 box 를 반환
+AABB computeTriangleBoxes(const std::vector<glm::vec3>& vertices, AABBArray& boxes) {
+    size_t count = vertices.size() / 3;
+    boxes.resize(count);
+
+    AABB bounds;
+    bounds.min = glm::vec3(std::numeric_limits<float>::max());
+    bounds.max = glm::vec3(-std::numeric_limits<float>::max());
+    for (size_t j = 0; j < count; ++j) {
+        AABB box = triangleAABB(&vertices[j * 3]);
+        boxes.set(j, box);
+        bounds = mergeAABB(bounds, box);
+    }
+    return bounds;
+}
+
+// b 삼각형 box 들을 SoA 로 모아 a 삼각형마다 SIMD 로 후보를 고른 뒤 정확히 검사
+bool findLeafCollision(const OctreeNode* a, const std::vector<glm::vec3>& transformedB,
+    AABBArray& boxesB, std::vector<uint64_t>& mask, size_t& triangleTests) {
+    if (a->triangles.empty() || transformedB.empty()) return false;
+
+    AABB boundsB = computeTriangleBoxes(transformedB, boxesB);
+    for (size_t i = 0; i < a->triangles.size(); ++i) {
+        const glm::vec3* triA = a->triangles[i].vertices;
+        AABB boxA = triangleAABB(triA);
+        if (!checkAABBCollision(boxA, boundsB)) continue;
+
+        overlapMask(boxA, boxesB, mask);
+
+        for (size_t w = 0; w < mask.size(); ++w) {
+            for (uint64_t bits = mask[w]; bits; bits &= bits - 1) {
+                size_t j = w * 64 + lowestBit(bits);
+                ++triangleTests;
+                if (checkTriangleCollision(triA, &transformedB[j * 3])) return true;
+            }
+        }
+    }
+    return false;
+}
+
+// box 의 8 꼭짓점이 두 변환 사이에서 움직이는 최대 거리 (affine 이므로 box 내부 점도 이 값 이하)
+float maxDisplacement(const AABB& box, const glm::mat4& from, const glm::mat4& to) {
+    glm::mat4 delta = to - from;
+    float result = 0.0f;
+    for (int i = 0; i < 8; ++i) {
+        glm::vec4 corner(
+            (i & 1) ? box.max.x : box.min.x,
+            (i & 2) ? box.max.y : box.min.y,
+            (i & 4) ? box.max.z : box.min.z,
+            1.0f);
+        result = glm::max(result, glm::length(glm::vec3(delta * corner)));
+    }
+    return result;
+}
+
+}
+
+bool checkTriangleCollision(const glm::vec3 tri1[3], const glm::vec3 tri2[3]) {
+    glm::vec3 edges1[3] = { tri1[1] - tri1[0], tri1[2] - tri1[1], tri1[0] - tri1[2] };
+    glm::vec3 edges2[3] = { tri2[1] - tri2[0], tri2[2] - tri2[1], tri2[0] - tri2[2] };
+    glm::vec3 normal1 = glm::cross(edges1[0], edges1[1]);
+    glm::vec3 normal2 = glm::cross(edges2[0], edges2[1]);
+
+    if (separatedOnAxis(normal1, tri1, tri2)) return false;
+    if (separatedOnAxis(normal2, tri1, tri2)) return false;
+
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            if (separatedOnAxis(glm::cross(edges1[i], edges2[j]), tri1, tri2)) return false;
+        }
+    }
+
+    // 같은 평면 위의 삼각형은 평면 안의 edge 법선으로 분리
+    glm::vec3 c = glm::cross(normal1, normal2);
+    if (glm::dot(c, c) <= 1e-6f * glm::dot(normal1, normal1) * glm::dot(normal2, normal2)) {
+        for (int i = 0; i < 3; ++i) {
+            if (separatedOnAxis(glm::cross(normal1, edges1[i]), tri1, tri2)) return false;
+            if (separatedOnAxis(glm::cross(normal1, edges2[i]), tri1, tri2)) return false;
+        }
+    }
+    return true;
+}
+
+bool collideLeaves(const OctreeNode* a, const OctreeNode* b, const glm::mat4& bToA) {
+    TraversalScratch scratch;
+    transformTriangles(b, bToA, scratch.transformedB);
+
+    size_t triangleTests = 0;
+    return findLeafCollision(a, scratch.transformedB, scratch.triangleBoxes, scratch.mask, triangleTests);
+}
+
+namespace {
+
+bool collideOctrees(const OctreeNode* a, const OctreeNode* b, const glm::mat4& bToA, TraversalScratch& scratch) {
+    if (!a || !b) return false;
+
+    size_t triangleTests = 0;
+    if (!boundsOverlap(a, b, bToA)) return false;
+
+    // stack 에는 bounds 가 겹치는 쌍만 들어간다
+    std::vector<NodePair>& stack = scratch.stack;
+    stack.clear();
+    stack.push_back({ a, b });
+    while (!stack.empty()) {
+        NodePair pair = stack.back();
+        stack.pop_back();
+
+        if (pair.a->isLeaf() && pair.b->isLeaf()) {
+            transformTriangles(pair.b, bToA, scratch.transformedB);
+            if (findLeafCollision(pair.a, scratch.transformedB, scratch.triangleBoxes, scratch.mask, triangleTests)) {
+                return true;
+            }
+            continue;
+        }
+
+        expandPair(pair.a, pair.b, bToA, [&](const OctreeNode* childA, const OctreeNode* childB, bool overlapping) {
+            if (overlapping) stack.push_back({ childA, childB });
+        });
+    }
+    return false;
+}
+
+}
+
+bool collideOctrees(const OctreeNode* a, const OctreeNode* b, const glm::mat4& bToA) {
+    TraversalScratch scratch;
+    return collideOctrees(a, b, bToA, scratch);
+}
+
+void collideBatch(const OctreeNode* a, const OctreeNode* b, const glm::mat4* poses, size_t poseCount,
+    std::vector<uint64_t>& results) {
+    results.assign((poseCount + 63) / 64, 0);
+
+    // grain 을 64 로 맞춰 각 작업이 결과 word 하나를 혼자 쓰게 한다
+    std::vector<TraversalScratch> scratches(getWorkerCount());
+    parallelFor(poseCount, 64, [&](size_t begin, size_t end, unsigned worker) {
+        TraversalScratch& scratch = scratches[worker];
+        uint64_t word = 0;
+        for (size_t i = begin; i < end; ++i) {
+            if (collideOctrees(a, b, poses[i], scratch)) {
+                word |= 1ull << (i & 63);
+            }
+        }
+        results[begin / 64] = word;
+    });
+}
+
+void collideBatch(const OctreeNode* a, const OctreeNode* b, const std::vector<glm::mat4>& poses,
+    std::vector<uint64_t>& results) {
+    collideBatch(a, b, poses.data(), poses.size(), results);
+}
+
+bool CollisionFront::needsFullTraversal(const OctreeNode* a, const OctreeNode* b, const glm::mat4& bToA) const {
+    if (!valid || a != rootA || b != rootB) return true;
+
+    glm::vec3 extent = a->bounds.max - a->bounds.min;
+    float limit = rebuildDistance * glm::length(extent);
+    if (glm::length(glm::vec3(bToA[3]) - glm::vec3(lastTransform[3])) > limit) return true;
+
+    for (int col = 0; col < 3; ++col) {
+        for (int row = 0; row < 3; ++row) {
+            if (std::fabs(bToA[col][row] - lastTransform[col][row]) > rebuildDistance) return true;
+        }
+    }
+    return false;
+}
+
+int CollisionFront::allocateCache() {
+    if (!freeCaches.empty()) {
+        int cache = freeCaches.back();
+        freeCaches.pop_back();
+        return cache;
+    }
+    caches.emplace_back();
+    return static_cast<int>(caches.size()) - 1;
+}
+
+void CollisionFront::releaseCache(FrontEntry& entry) {
+    if (entry.cache >= 0) {
+        caches[entry.cache].candidates.clear();
+        freeCaches.push_back(entry.cache);
+    }
+    entry.cache = noCache;
+}
+
+bool CollisionFront::testLeaves(FrontEntry& entry, const glm::mat4& bToA) {
+    const OctreeNode* a = entry.a;
+    const OctreeNode* b = entry.b;
+
+    // 처음 겹친 leaf 쌍은 후보 목록 없이 바로 검사하고, 다음 프레임에도 겹치면 목록을 만든다
+    if (entry.cache == noCache) {
+        entry.cache = pendingCache;
+        transformTriangles(b, bToA, transformedB);
+        return findLeafCollision(a, transformedB, triangleBoxes, mask, stats.triangleTests);
+    }
+
+    bool rebuild = entry.cache < 0;
+    if (!rebuild) {
+        const LeafCache& cache = caches[entry.cache];
+        rebuild = maxDisplacement(b->bounds, cache.transform, bToA) >= cache.margin;
+    }
+
+    if (rebuild) {
+        if (entry.cache < 0) entry.cache = allocateCache();
+        LeafCache& cache = caches[entry.cache];
+        cache.transform = bToA;
+        cache.margin = cacheMargin * glm::length(b->bounds.max - b->bounds.min);
+        cache.candidates.clear();
+
+        // b 삼각형 box 를 margin 만큼 키워 SoA 로 만들고 a 삼각형마다 SIMD 로 비교
+        transformTriangles(b, bToA, transformedB);
+        AABB boundsB = computeTriangleBoxes(transformedB, triangleBoxes);
+        glm::vec3 margin(cache.margin);
+        for (size_t j = 0; j < triangleBoxes.count; ++j) {
+            AABB boxB = triangleBoxes.get(j);
+            boxB.min -= margin;
+            boxB.max += margin;
+            triangleBoxes.set(j, boxB);
+        }
+        boundsB.min -= margin;
+        boundsB.max += margin;
+
+        for (size_t i = 0; i < a->triangles.size(); ++i) {
+            AABB boxA = triangleAABB(a->triangles[i].vertices);
+            if (!checkAABBCollision(boxA, boundsB)) continue;
+
+            overlapMask(boxA, triangleBoxes, mask);
+            for (size_t w = 0; w < mask.size(); ++w) {
+                for (uint64_t bits = mask[w]; bits; bits &= bits - 1) {
+                    size_t j = w * 64 + lowestBit(bits);
+                    cache.candidates.push_back((static_cast<uint64_t>(i) << 32) | j);
+                }
+            }
+        }
+    }
+
+    // 후보만 정확히 검사. 맞은 쌍은 앞으로 옮겨 다음 프레임에 먼저 검사한다
+    std::vector<uint64_t>& candidates = caches[entry.cache].candidates;
+    for (size_t k = 0; k < candidates.size(); ++k) {
+        size_t i = static_cast<size_t>(candidates[k] >> 32);
+        size_t j = static_cast<size_t>(candidates[k] & 0xffffffffu);
+
+        glm::vec3 triB[3];
+        for (int v = 0; v < 3; ++v) {
+            triB[v] = glm::vec3(bToA * glm::vec4(b->triangles[j].vertices[v], 1.0f));
+        }
+        if (!checkAABBCollision(triangleAABB(a->triangles[i].vertices), triangleAABB(triB))) continue;
+
+        ++stats.triangleTests;
+        if (checkTriangleCollision(a->triangles[i].vertices, triB)) {
+            std::swap(candidates[0], candidates[k]);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CollisionFront::update(const OctreeNode* a, const OctreeNode* b, const glm::mat4& bToA) {
+    stats = CollisionFrontStats();
+    collidingPairs.clear();
+
+    if (!a || !b) {
+        front.clear();
+        valid = false;
+        return false;
+    }
+
+    bool full = needsFullTraversal(a, b, bToA);
+    if (full) {
+        front.clear();
+        caches.clear();
+        freeCaches.clear();
+        front.push_back({ a, b, noCache });
+    }
+
+    // front 의 각 쌍을 pair-array kernel 로 한 번에 다시 검사: 떨어져 있으면 그대로 두고, 겹치면 아래로 확장
+    frontBoundsA.resize(front.size());
+    frontBoundsB.resize(front.size());
+    for (size_t i = 0; i < front.size(); ++i) {
+        frontBoundsA.set(i, front[i].a->bounds);
+        frontBoundsB.set(i, transformAABB(front[i].b->bounds, bToA));
+    }
+    overlapPairs(frontBoundsA, frontBoundsB, mask);
+    stats.boxTests += front.size();
+
+    stack.clear();
+    nextFront.clear();
+    for (size_t i = front.size(); i-- > 0;) {
+        FrontEntry entry = front[i];
+        if (testMaskBit(mask, i)) {
+            stack.push_back(entry);
+        }
+        else {
+            releaseCache(entry);
+            nextFront.push_back(entry);
+        }
+    }
+
+    // stack 에는 bounds 가 겹치는 쌍만 들어간다
+    while (!stack.empty()) {
+        FrontEntry entry = stack.back();
+        stack.pop_back();
+
+        if (entry.a->isLeaf() && entry.b->isLeaf()) {
+            if (testLeaves(entry, bToA)) {
+                collidingPairs.push_back({ entry.a, entry.b });
+            }
+            nextFront.push_back(entry);
+            continue;
+        }
+
+        expandPair(entry.a, entry.b, bToA, [&](const OctreeNode* childA, const OctreeNode* childB, bool overlapping) {
+            ++stats.boxTests;
+            if (overlapping) {
+                stack.push_back({ childA, childB, noCache });
+            }
+            else {
+                nextFront.push_back({ childA, childB, noCache });
+            }
+        });
+    }
+    front.swap(nextFront);
+
+    rootA = a;
+    rootB = b;
+    lastTransform = bToA;
+    valid = true;
+
+    // front 는 위로 합쳐지지 않으므로 처음보다 많이 커지면 다음 프레임에 새로 만든다
+    if (full) {
+        fullFrontSize = front.size();
+    }
+    else if (front.size() > fullFrontSize * 2 + 64) {
+        valid = false;
+    }
+
+    stats.frontSize = front.size();
+    stats.fullTraversal = full;
+    return !collidingPairs.empty();
+}
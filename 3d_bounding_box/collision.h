@@ -0,0 +1,90 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm/glm.hpp>
+#include "aabb_simd.h"
+#include "geometry.h"
+#include "octree.h"
+
+struct NodePair {
+    const OctreeNode* a;
+    const OctreeNode* b;
+};
+
+bool checkTriangleCollision(const glm::vec3 tri1[3], const glm::vec3 tri2[3]);
+
+// b 의 좌표계를 a 의 좌표계로 옮기는 bToA 를 받아 두 octree 의 삼각형 충돌을 검사한다
+bool collideOctrees(const OctreeNode* a, const OctreeNode* b, const glm::mat4& bToA);
+bool collideLeaves(const OctreeNode* a, const OctreeNode* b, const glm::mat4& bToA);
+
+// 한 쌍의 octree 를 여러 자세(poses[i] = bToA)에서 검사한다. 트리는 읽기 전용으로 스레드 간에
+// 공유하고 탐색 버퍼는 스레드마다 한 번만 만든다. 결과는 pose i 가 bit (i % 64) of results[i / 64].
+void collideBatch(const OctreeNode* a, const OctreeNode* b, const glm::mat4* poses, size_t poseCount,
+    std::vector<uint64_t>& results);
+void collideBatch(const OctreeNode* a, const OctreeNode* b, const std::vector<glm::mat4>& poses,
+    std::vector<uint64_t>& results);
+
+struct CollisionFrontStats {
+    size_t frontSize = 0;
+    size_t boxTests = 0;
+    size_t triangleTests = 0;
+    bool fullTraversal = false;
+};
+
+// 이전 프레임에서 탐색이 멈춘 노드 쌍(collision front)을 저장해 두고
+// 다음 프레임에는 그 지점부터 다시 확인/확장한다. 많이 움직였으면 root 부터 다시 탐색한다.
+class CollisionFront {
+public:
+    bool update(const OctreeNode* a, const OctreeNode* b, const glm::mat4& bToA);
+    void reset() { valid = false; }
+
+    const std::vector<NodePair>& getCollidingPairs() const { return collidingPairs; }
+    const CollisionFrontStats& getStats() const { return stats; }
+
+    // root bounds 대각선 대비 이동량이 이 비율을 넘으면 전체 탐색
+    float rebuildDistance = 0.25f;
+    // leaf 쌍의 삼각형 후보 목록을 다시 만들기 전까지 허용하는 이동량 (leaf bounds 대각선 대비)
+    float cacheMargin = 0.05f;
+
+private:
+    static const int noCache = -1;
+    static const int pendingCache = -2;
+
+    struct FrontEntry {
+        const OctreeNode* a;
+        const OctreeNode* b;
+        int cache;
+    };
+
+    // 겹치는 leaf 쌍에서 margin 만큼 키운 삼각형 box 가 겹치는 쌍만 모아 둔다.
+    // 이후 이동량이 margin 보다 작으면 목록 밖의 쌍은 여전히 떨어져 있다.
+    struct LeafCache {
+        glm::mat4 transform;
+        float margin;
+        std::vector<uint64_t> candidates;  // (a 삼각형 << 32) | b 삼각형
+    };
+
+    bool needsFullTraversal(const OctreeNode* a, const OctreeNode* b, const glm::mat4& bToA) const;
+    bool testLeaves(FrontEntry& entry, const glm::mat4& bToA);
+    int allocateCache();
+    void releaseCache(FrontEntry& entry);
+
+    std::vector<FrontEntry> front;
+    std::vector<FrontEntry> nextFront;
+    std::vector<FrontEntry> stack;
+    std::vector<NodePair> collidingPairs;
+    std::vector<LeafCache> caches;
+    std::vector<int> freeCaches;
+    std::vector<glm::vec3> transformedB;
+    AABBArray triangleBoxes;
+    AABBArray frontBoundsA;
+    AABBArray frontBoundsB;
+    std::vector<uint64_t> mask;
+    const OctreeNode* rootA = nullptr;
+    const OctreeNode* rootB = nullptr;
+    glm::mat4 lastTransform;
+    size_t fullFrontSize = 0;
+    bool valid = false;
+    CollisionFrontStats stats;
+};
@@ -0,0 +1,246 @@
+﻿#include "collision_lod.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <utility>
+#include "closest_point.h"
+#include "collision.h"
+#include "mesh_simplify.h"
+#include "parallel.h"
+
+namespace {
+
+// 두 선분 사이 거리의 제곱 (Ericson, Real-Time Collision Detection 5.1.9)
+float segmentDistanceSq(const glm::vec3& p1, const glm::vec3& q1, const glm::vec3& p2, const glm::vec3& q2) {
+    const float epsilon = 1e-12f;
+    glm::vec3 d1 = q1 - p1;
+    glm::vec3 d2 = q2 - p2;
+    glm::vec3 r = p1 - p2;
+    float a = glm::dot(d1, d1);
+    float e = glm::dot(d2, d2);
+    float f = glm::dot(d2, r);
+
+    float s = 0.0f;
+    float t = 0.0f;
+    if (a <= epsilon && e <= epsilon) {
+        return glm::dot(r, r);
+    }
+    if (a <= epsilon) {
+        t = glm::clamp(f / e, 0.0f, 1.0f);
+    }
+    else {
+        float c = glm::dot(d1, r);
+        if (e <= epsilon) {
+            s = glm::clamp(-c / a, 0.0f, 1.0f);
+        }
+        else {
+            float b = glm::dot(d1, d2);
+            float denom = a * e - b * b;
+            s = denom != 0.0f ? glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+            t = (b * s + f) / e;
+            if (t < 0.0f) {
+                t = 0.0f;
+                s = glm::clamp(-c / a, 0.0f, 1.0f);
+            }
+            else if (t > 1.0f) {
+                t = 1.0f;
+                s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+            }
+        }
+    }
+
+    glm::vec3 diff = (p1 + d1 * s) - (p2 + d2 * t);
+    return glm::dot(diff, diff);
+}
+
+// b 의 세 꼭짓점이 모두 a 평면의 한쪽에 margin 보다 멀리 있으면 두 삼각형 사이 거리도 margin 보다 크다
+bool separatedByPlane(const glm::vec3 a[3], const glm::vec3 b[3], float margin) {
+    glm::vec3 normal = glm::cross(a[1] - a[0], a[2] - a[0]);
+    float length = glm::length(normal);
+    if (!(length > 0.0f)) return false;
+
+    float d0 = glm::dot(normal, b[0] - a[0]);
+    float d1 = glm::dot(normal, b[1] - a[0]);
+    float d2 = glm::dot(normal, b[2] - a[0]);
+    float limit = margin * length;
+    return (d0 > limit && d1 > limit && d2 > limit) || (d0 < -limit && d1 < -limit && d2 < -limit);
+}
+
+// 교차하지 않으면 최단 거리는 꼭짓점-삼각형 6쌍과 모서리-모서리 9쌍 중 하나에서 나온다
+float triangleDistanceSq(const glm::vec3 a[3], const glm::vec3 b[3]) {
+    if (checkTriangleCollision(a, b)) return 0.0f;
+
+    float best = FLT_MAX;
+    for (int i = 0; i < 3; ++i) {
+        glm::vec3 toB = a[i] - closestPointOnTriangle(a[i], b);
+        glm::vec3 toA = b[i] - closestPointOnTriangle(b[i], a);
+        best = std::min(best, std::min(glm::dot(toB, toB), glm::dot(toA, toA)));
+        for (int j = 0; j < 3; ++j) {
+            best = std::min(best, segmentDistanceSq(a[i], a[(i + 1) % 3], b[j], b[(j + 1) % 3]));
+        }
+    }
+    return best;
+}
+
+AABB inflate(const AABB& box, float margin) {
+    AABB result;
+    result.min = box.min - glm::vec3(margin);
+    result.max = box.max + glm::vec3(margin);
+    return result;
+}
+
+AABB triangleBox(const glm::vec3 v[3]) {
+    AABB box;
+    box.min = glm::min(glm::min(v[0], v[1]), v[2]);
+    box.max = glm::max(glm::max(v[0], v[1]), v[2]);
+    return box;
+}
+
+float boxVolume(const AABB& box) {
+    glm::vec3 d = box.max - box.min;
+    return d.x * d.y * d.z;
+}
+
+// a 와 (bToA 로 옮긴) b 의 표면 사이 거리가 margin 이하인 삼각형 쌍이 있는지
+bool withinDistance(const OctreeNode* a, const OctreeNode* b, const glm::mat4& bToA, float margin) {
+    if (!a || !b) return false;
+
+    float marginSq = margin * margin;
+    thread_local std::vector<NodePair> stack;
+    thread_local std::vector<glm::vec3> transformedB;
+    stack.clear();
+    stack.push_back({ a, b });
+    while (!stack.empty()) {
+        NodePair pair = stack.back();
+        stack.pop_back();
+        if (!checkAABBCollision(inflate(pair.a->bounds, margin), transformAABB(pair.b->bounds, bToA))) continue;
+
+        if (pair.a->isLeaf() && pair.b->isLeaf()) {
+            transformedB.clear();
+            for (const auto& tri : pair.b->triangles) {
+                for (int i = 0; i < 3; ++i) {
+                    transformedB.push_back(glm::vec3(bToA * glm::vec4(tri.vertices[i], 1.0f)));
+                }
+            }
+            for (const auto& triA : pair.a->triangles) {
+                AABB boxA = inflate(triangleBox(triA.vertices), margin);
+                for (size_t j = 0; j < transformedB.size(); j += 3) {
+                    const glm::vec3* triB = &transformedB[j];
+                    if (!checkAABBCollision(boxA, triangleBox(triB)) ||
+                        separatedByPlane(triA.vertices, triB, margin) || separatedByPlane(triB, triA.vertices, margin)) {
+                        continue;
+                    }
+                    if (triangleDistanceSq(triA.vertices, triB) <= marginSq) {
+                        return true;
+                    }
+                }
+            }
+            continue;
+        }
+
+        bool descendA = !pair.a->isLeaf() && (pair.b->isLeaf() || boxVolume(pair.a->bounds) >= boxVolume(pair.b->bounds));
+        const OctreeNode* parent = descendA ? pair.a : pair.b;
+        for (int i = 0; i < 8; ++i) {
+            if (!parent->children[i]) continue;
+            stack.push_back(descendA ? NodePair{ parent->children[i], pair.b } : NodePair{ pair.a, parent->children[i] });
+        }
+    }
+    return false;
+}
+
+// from 표면의 모든 점에서 coarse 표면까지 거리의 상한. 고정된 삼각형까지의 거리는 볼록 함수라
+// from 삼각형 위의 최댓값은 꼭짓점에서 나온다. 그래서 from 삼각형마다 coarse 삼각형 하나까지 세 꼭짓점 거리의
+// 최댓값이 그 삼각형 전체의 상한이 된다. 후보는 꼭짓점과 중심의 최근접 삼각형이고 그중 가장 작은 값을 쓴다
+float surfaceDistanceBound(const OctreeNode* tree, const std::vector<Triangle>& coarse, const IndexedMesh& from) {
+    size_t vertexCount = from.vertices.size();
+    size_t triangleCount = from.getTriangleCount();
+    std::vector<glm::vec3> points(from.vertices);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        points.push_back((from.vertices[from.indices[t * 3]] + from.vertices[from.indices[t * 3 + 1]] +
+            from.vertices[from.indices[t * 3 + 2]]) / 3.0f);
+    }
+    std::vector<ClosestPointResult> results(points.size());
+    closestPoints(tree, points.data(), points.size(), results.data());
+
+    std::vector<float> workerBound(getWorkerCount(), 0.0f);
+    parallelFor(triangleCount, 1024, [&](size_t begin, size_t end, unsigned worker) {
+        for (size_t t = begin; t < end; ++t) {
+            glm::vec3 v[3];
+            int candidates[4];
+            for (int k = 0; k < 3; ++k) {
+                int index = from.indices[t * 3 + k];
+                v[k] = from.vertices[index];
+                candidates[k] = results[index].triangle;
+            }
+            candidates[3] = results[vertexCount + t].triangle;
+
+            float best = FLT_MAX;
+            for (int c = 0; c < 4; ++c) {
+                if (candidates[c] < 0) continue;
+                const glm::vec3* triangle = coarse[candidates[c]].vertices;
+                float farthest = 0.0f;
+                for (int k = 0; k < 3; ++k) {
+                    farthest = std::max(farthest, glm::length(v[k] - closestPointOnTriangle(v[k], triangle)));
+                }
+                best = std::min(best, farthest);
+            }
+            workerBound[worker] = std::max(workerBound[worker], best);
+        }
+    });
+    return *std::max_element(workerBound.begin(), workerBound.end());
+}
+
+}
+
+CollisionLods::~CollisionLods() {
+    clear();
+}
+
+void CollisionLods::clear() {
+    for (auto& level : levels) {
+        deleteOctree(level.tree);
+    }
+    levels.clear();
+    tree = nullptr;
+}
+
+void CollisionLods::build(const IndexedMesh& mesh, const OctreeNode* tree, float ratio, size_t minTriangles) {
+    clear();
+    this->tree = tree;
+    ratio = glm::clamp(ratio, 0.01f, 0.9f);
+
+    for (;;) {
+        const IndexedMesh& previous = levels.empty() ? mesh : levels.back().mesh;
+        size_t target = static_cast<size_t>(previous.getTriangleCount() * ratio);
+        if (target < minTriangles) break;
+
+        CollisionLodLevel level;
+        level.mesh = simplifyMesh(previous, target);
+        // 더 합칠 수 있는 edge 가 거의 남지 않았으면 멈춘다
+        if (level.mesh.getTriangleCount() * 10 > previous.getTriangleCount() * 9) break;
+
+        // 누적하지 않고 원래 mesh 에서 바로 잰다 (더 작고, level 사이 오차를 더할 필요가 없다)
+        std::vector<Triangle> triangles = toTriangles(level.mesh);
+        level.tree = buildOctree(calculateAABB(triangles), triangles, 0);
+        level.error = surfaceDistanceBound(level.tree, triangles, mesh);
+        levels.push_back(std::move(level));
+    }
+}
+
+bool collideLods(const CollisionLods& a, const CollisionLods& b, const glm::mat4& bToA, CollisionLodStats* stats) {
+    if (stats) *stats = CollisionLodStats();
+
+    // 중간 level 은 원래 mesh 와 비용 차이가 크지 않아 거치지 않고 가장 거친 level 에서 바로 원래 octree 로 넘어간다
+    const std::vector<CollisionLodLevel>& levelsA = a.getLevels();
+    const std::vector<CollisionLodLevel>& levelsB = b.getLevels();
+    if (!levelsA.empty() || !levelsB.empty()) {
+        const OctreeNode* treeA = levelsA.empty() ? a.getTree() : levelsA.back().tree;
+        const OctreeNode* treeB = levelsB.empty() ? b.getTree() : levelsB.back().tree;
+        float margin = (levelsA.empty() ? 0.0f : levelsA.back().error) + (levelsB.empty() ? 0.0f : levelsB.back().error);
+        if (stats) ++stats->levelTests;
+        if (!withinDistance(treeA, treeB, bToA, margin)) return false;
+    }
+
+    if (stats) stats->refined = true;
+    return collideOctrees(a.getTree(), b.getTree(), bToA);
+}
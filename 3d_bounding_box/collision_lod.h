@@ -0,0 +1,43 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm/glm.hpp>
+#include "mesh.h"
+#include "octree.h"
+
+struct CollisionLodLevel {
+    IndexedMesh mesh;
+    OctreeNode* tree = nullptr;
+    float error = 0.0f;  // 원래 표면의 모든 점에서 이 level 표면까지 거리의 상한
+};
+
+struct CollisionLodStats {
+    size_t levelTests = 0;  // 거친 level 에서 한 거리 검사 수
+    bool refined = false;   // 원래 octree 까지 내려갔는지
+};
+
+// simplifyMesh 로 삼각형 수를 ratio 배씩 줄인 LOD 목록. levels 는 고운 것부터 거친 순서이고
+// 원래 mesh 의 octree 는 빌려 쓰기만 한다
+class CollisionLods {
+public:
+    CollisionLods() = default;
+    CollisionLods(const CollisionLods&) = delete;
+    CollisionLods& operator=(const CollisionLods&) = delete;
+    ~CollisionLods();
+
+    // level 오차는 원래 mesh 삼각형마다 가까운 level 삼각형까지의 꼭짓점 거리로 구한 상한이다
+    void build(const IndexedMesh& mesh, const OctreeNode* tree, float ratio = 0.25f, size_t minTriangles = 256);
+    void clear();
+
+    const OctreeNode* getTree() const { return tree; }
+    const std::vector<CollisionLodLevel>& getLevels() const { return levels; }
+
+private:
+    const OctreeNode* tree = nullptr;
+    std::vector<CollisionLodLevel> levels;
+};
+
+// 가장 거친 두 level 의 표면이 두 오차의 합보다 멀면 원래 표면도 만나지 않으므로 false.
+// 가까우면 collideOctrees 로 원래 octree 를 정확히 검사한다. bToA 는 길이를 보존하는 강체 변환이어야 한다
+bool collideLods(const CollisionLods& a, const CollisionLods& b, const glm::mat4& bToA, CollisionLodStats* stats = nullptr);
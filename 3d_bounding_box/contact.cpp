@@ -0,0 +1,176 @@
+﻿#include "contact.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "closest_point.h"
+
+const int ContactManifold::maxPoints;
+
+namespace {
+
+struct Candidate {
+    glm::vec3 position;  // a 좌표계
+    float depth;
+    bool fromB;          // b 꼭짓점이면 true (fieldA 로 잰 점)
+};
+
+// b 를 frame 으로 옮긴 꼭짓점 중 field 안으로 margin 이상 들어온 것을 candidates 에 추가한다
+void collectCandidates(const DistanceField& field, const IndexedMesh& mesh, const glm::mat4& meshToField,
+    const glm::mat4& fieldToA, bool fromB, float margin, std::vector<float>& distances,
+    std::vector<Candidate>& candidates) {
+    distances.resize(mesh.vertices.size());
+    field.sample(mesh.vertices.data(), mesh.vertices.size(), meshToField, distances.data());
+    for (size_t i = 0; i < distances.size(); ++i) {
+        if (distances[i] < margin) {
+            Candidate candidate;
+            candidate.position = glm::vec3(fieldToA * meshToField * glm::vec4(mesh.vertices[i], 1.0f));
+            candidate.depth = -distances[i];
+            candidate.fromB = fromB;
+            candidates.push_back(candidate);
+        }
+    }
+}
+
+// field 좌표계의 점 p 에서 표면 바깥 방향과 겹친 깊이. narrow band 밖의 brick 은 값이 하나뿐이라
+// 기울기가 0 이고 거리도 하한일 뿐이므로, 그때는 tree 에서 최근접점을 찾는다
+void surfaceContact(const DistanceField& field, const OctreeNode* tree, const glm::vec3& p,
+    glm::vec3& normal, float& depth) {
+    normal = distanceFieldGradient(field, p);
+    bool inBand = std::abs(depth) < field.getNarrowBand();
+    if (!tree || (inBand && normal != glm::vec3(0.0f))) return;
+
+    ClosestPointResult closest = closestPoint(tree, p);
+    if (closest.triangle < 0) return;
+    bool inside = depth > 0.0f;
+    depth = inside ? closest.distance : -closest.distance;
+    glm::vec3 direction = inside ? closest.point - p : p - closest.point;
+    float length = glm::length(direction);
+    if (length > 0.0f) normal = direction / length;
+}
+
+}
+
+glm::vec3 distanceFieldGradient(const DistanceField& field, const glm::vec3& p) {
+    float h = 0.5f * field.getCellSize();
+    glm::vec3 gradient(
+        field.sample(p + glm::vec3(h, 0.0f, 0.0f)) - field.sample(p - glm::vec3(h, 0.0f, 0.0f)),
+        field.sample(p + glm::vec3(0.0f, h, 0.0f)) - field.sample(p - glm::vec3(0.0f, h, 0.0f)),
+        field.sample(p + glm::vec3(0.0f, 0.0f, h)) - field.sample(p - glm::vec3(0.0f, 0.0f, h)));
+    float length = glm::length(gradient);
+    return length > 0.0f ? gradient / length : glm::vec3(0.0f);
+}
+
+bool computeContacts(const DistanceField& fieldA, const OctreeNode* treeA, const IndexedMesh& meshA,
+    const DistanceField* fieldB, const OctreeNode* treeB, const IndexedMesh& meshB,
+    const glm::mat4& bToA, ContactManifold& manifold, float margin) {
+    manifold = ContactManifold();
+
+    thread_local std::vector<float> distances;
+    thread_local std::vector<Candidate> candidates;
+    candidates.clear();
+    collectCandidates(fieldA, meshB, bToA, glm::mat4(1.0f), true, margin, distances, candidates);
+    glm::mat4 aToB = glm::inverse(bToA);
+    if (fieldB) {
+        collectCandidates(*fieldB, meshA, aToB, bToA, false, margin, distances, candidates);
+    }
+    if (candidates.empty()) {
+        return false;
+    }
+
+    // 가장 깊은 점
+    int chosen[ContactManifold::maxPoints];
+    int count = 0;
+    size_t deepest = 0;
+    for (size_t i = 1; i < candidates.size(); ++i) {
+        if (candidates[i].depth > candidates[deepest].depth) deepest = i;
+    }
+    chosen[count++] = static_cast<int>(deepest);
+    const glm::vec3 a = candidates[deepest].position;
+
+    // 그 점에서 가장 먼 점
+    float best = 0.0f;
+    int farthest = -1;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        glm::vec3 d = candidates[i].position - a;
+        float distanceSq = glm::dot(d, d);
+        if (distanceSq > best) {
+            best = distanceSq;
+            farthest = static_cast<int>(i);
+        }
+    }
+
+    if (farthest >= 0) {
+        chosen[count++] = farthest;
+        const glm::vec3 b = candidates[farthest].position;
+
+        // 삼각형 넓이가 가장 큰 점
+        best = 0.0f;
+        int widest = -1;
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            glm::vec3 n = glm::cross(b - a, candidates[i].position - a);
+            float areaSq = glm::dot(n, n);
+            if (areaSq > best) {
+                best = areaSq;
+                widest = static_cast<int>(i);
+            }
+        }
+
+        if (widest >= 0) {
+            chosen[count++] = widest;
+            const glm::vec3 c = candidates[widest].position;
+            glm::vec3 n = glm::cross(b - a, c - a);
+
+            // 삼각형 abc 의 모서리 바깥으로 가장 멀리 나간 점
+            const glm::vec3 corners[3] = { a, b, c };
+            best = 0.0f;
+            int outside = -1;
+            for (size_t i = 0; i < candidates.size(); ++i) {
+                float minArea = 0.0f;
+                for (int e = 0; e < 3; ++e) {
+                    const glm::vec3& p0 = corners[e];
+                    const glm::vec3& p1 = corners[(e + 1) % 3];
+                    minArea = std::min(minArea, glm::dot(glm::cross(p1 - p0, candidates[i].position - p0), n));
+                }
+                if (minArea < best) {
+                    best = minArea;
+                    outside = static_cast<int>(i);
+                }
+            }
+            if (outside >= 0) {
+                chosen[count++] = outside;
+            }
+        }
+    }
+
+    // 고른 점에서만 기울기를 구한다. a 꼭짓점은 b 표면의 바깥 방향을 뒤집어 a 좌표계로 옮긴다
+    glm::mat3 bRotation(bToA);
+    for (int i = 0; i < count; ++i) {
+        const Candidate& candidate = candidates[chosen[i]];
+        ContactPoint& point = manifold.points[i];
+        point.position = candidate.position;
+        point.depth = candidate.depth;
+        if (candidate.fromB) {
+            surfaceContact(fieldA, treeA, candidate.position, point.normal, point.depth);
+        }
+        else {
+            glm::vec3 local(aToB * glm::vec4(candidate.position, 1.0f));
+            glm::vec3 normal;
+            surfaceContact(*fieldB, treeB, local, normal, point.depth);
+            point.normal = -(bRotation * normal);
+        }
+
+        manifold.normal += point.normal * std::max(point.depth, 0.0f);
+        manifold.depth = std::max(manifold.depth, point.depth);
+    }
+    manifold.count = count;
+
+    float length = glm::length(manifold.normal);
+    if (length > 0.0f) {
+        manifold.normal /= length;
+    }
+    else if (count > 0) {
+        manifold.normal = manifold.points[0].normal;
+    }
+    return manifold.depth > 0.0f;
+}
@@ -0,0 +1,33 @@
+﻿#pragma once
+
+#include <glm/glm/glm.hpp>
+#include "distance_field.h"
+#include "mesh.h"
+
+// position, normal 은 a 좌표계. normal 은 a 표면 바깥 방향(b 를 밀어낼 방향)이고 depth > 0 이면 겹친 깊이
+struct ContactPoint {
+    glm::vec3 position;
+    glm::vec3 normal;
+    float depth;
+};
+
+struct ContactManifold {
+    static const int maxPoints = 4;
+
+    ContactPoint points[maxPoints];
+    int count = 0;
+    glm::vec3 normal = glm::vec3(0.0f);  // 점 normal 을 깊이로 가중 평균한 값
+    float depth = 0.0f;                  // 점 depth 의 최댓값
+};
+
+// b 꼭짓점을 a 의 distance field 로, a 꼭짓점을 b 의 distance field 로 검사해 겹친 점을 모은 뒤
+// 가장 깊은 점, 그 점에서 가장 먼 점, 넓이를 최대로 만드는 점 순서로 최대 4개를 고른다.
+// normal 은 고른 점에서만 distance field 의 기울기로 구하므로 비용은 꼭짓점 수에 비례한다.
+// 고른 점이 narrow band 보다 깊어 기울기가 0 이면 tree 의 최근접점으로 normal 과 depth 를 다시 구한다 (tree 가 있을 때).
+// fieldB 가 nullptr 이면 b 꼭짓점만 본다. margin 만큼 떨어진 점도 음수 depth 로 포함한다
+bool computeContacts(const DistanceField& fieldA, const OctreeNode* treeA, const IndexedMesh& meshA,
+    const DistanceField* fieldB, const OctreeNode* treeB, const IndexedMesh& meshB,
+    const glm::mat4& bToA, ContactManifold& manifold, float margin = 0.0f);
+
+// 중앙 차분으로 구한 distance field 의 기울기(정규화). 평평하면 0 벡터
+glm::vec3 distanceFieldGradient(const DistanceField& field, const glm::vec3& p);
@@ -0,0 +1,109 @@
+﻿#include "containment.h"
+
+#include <algorithm>
+#include <limits>
+#include "parallel.h"
+#include "raycast.h"
+
+namespace {
+
+// 축과 나란하면 삼각형 모서리, 꼭짓점과 정확히 만나기 쉬우므로 조금씩 기울인 방향을 쓴다
+const glm::vec3 parityDirections[3] = {
+    glm::vec3(1.0f, 0.0123f, 0.0271f),
+    glm::vec3(0.0179f, 1.0f, -0.0311f),
+    glm::vec3(-0.0237f, 0.0143f, 1.0f),
+};
+
+struct ParityScratch {
+    std::vector<const OctreeNode*> stack;
+    std::vector<int> hits;
+};
+
+// 광선이 지나는 서로 다른 삼각형 수가 홀수인지. 삼각형은 여러 leaf 에 복사되어 있으므로 번호로 중복을 지운다
+bool crossesOddTimes(const OctreeNode* tree, const glm::vec3& origin, const glm::vec3& direction,
+    ParityScratch& scratch) {
+    const float tMax = std::numeric_limits<float>::max();
+    glm::vec3 invDirection = 1.0f / direction;
+
+    scratch.stack.clear();
+    scratch.hits.clear();
+    scratch.stack.push_back(tree);
+
+    while (!scratch.stack.empty()) {
+        const OctreeNode* node = scratch.stack.back();
+        scratch.stack.pop_back();
+
+        float tNear;
+        if (!intersectRayAABB(origin, invDirection, node->bounds, tMax, tNear)) {
+            continue;
+        }
+
+        if (node->isLeaf()) {
+            for (size_t i = 0; i < node->triangles.size(); ++i) {
+                float t;
+                glm::vec2 barycentric;
+                if (intersectRayTriangle(origin, direction, node->triangles[i].vertices, t, barycentric) && t >= 0.0f) {
+                    scratch.hits.push_back(node->triangleIds[i]);
+                }
+            }
+            continue;
+        }
+
+        for (int i = 0; i < 8; ++i) {
+            if (node->children[i]) {
+                scratch.stack.push_back(node->children[i]);
+            }
+        }
+    }
+
+    std::sort(scratch.hits.begin(), scratch.hits.end());
+    size_t crossings = std::unique(scratch.hits.begin(), scratch.hits.end()) - scratch.hits.begin();
+    return (crossings & 1) != 0;
+}
+
+bool containsPoint(const OctreeNode* tree, const glm::vec3& point, ParityScratch& scratch) {
+    const AABB& bounds = tree->bounds;
+    if (glm::any(glm::lessThan(point, bounds.min)) || glm::any(glm::greaterThan(point, bounds.max))) {
+        return false;
+    }
+
+    int votes = 0;
+    for (int i = 0; i < 3; ++i) {
+        if (crossesOddTimes(tree, point, parityDirections[i], scratch)) {
+            ++votes;
+        }
+        // 앞의 두 결과가 같으면 세 번째는 결과를 바꾸지 못한다
+        if (i == 1 && votes != 1) break;
+    }
+    return votes >= 2;
+}
+
+}
+
+bool containsPoint(const OctreeNode* tree, const glm::vec3& point) {
+    if (!tree) return false;
+    ParityScratch scratch;
+    return containsPoint(tree, point, scratch);
+}
+
+void containsPoints(const OctreeNode* tree, const glm::vec3* points, size_t count, std::vector<uint64_t>& results) {
+    results.assign((count + 63) / 64, 0);
+    if (!tree) return;
+
+    // grain 을 64 로 맞춰 각 작업이 결과 word 하나를 혼자 쓰게 한다
+    std::vector<ParityScratch> scratches(getWorkerCount());
+    parallelFor(count, 64, [&](size_t begin, size_t end, unsigned worker) {
+        ParityScratch& scratch = scratches[worker];
+        uint64_t word = 0;
+        for (size_t i = begin; i < end; ++i) {
+            if (containsPoint(tree, points[i], scratch)) {
+                word |= 1ull << (i & 63);
+            }
+        }
+        results[begin / 64] = word;
+    });
+}
+
+void containsPoints(const OctreeNode* tree, const std::vector<glm::vec3>& points, std::vector<uint64_t>& results) {
+    containsPoints(tree, points.data(), points.size(), results);
+}
@@ -0,0 +1,15 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm/glm.hpp>
+#include "octree.h"
+
+// 점에서 서로 다른 방향으로 광선 3개를 쏘아 각각 교차 삼각형 수의 홀짝을 세고 다수결로 판단한다.
+// mesh 가 닫혀 있어야 의미가 있고, 광선이 모서리를 지나 한 방향이 틀려도 나머지 둘이 맞으면 된다.
+bool containsPoint(const OctreeNode* tree, const glm::vec3& point);
+
+// 점마다 containsPoint. 결과는 점 i 가 bit (i % 64) of results[i / 64]
+void containsPoints(const OctreeNode* tree, const glm::vec3* points, size_t count, std::vector<uint64_t>& results);
+void containsPoints(const OctreeNode* tree, const std::vector<glm::vec3>& points, std::vector<uint64_t>& results);
@@ -0,0 +1,464 @@
+﻿#include "convex_decomposition.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <utility>
+#include "aabb_simd.h"
+#include "containment.h"
+#include "convex_hull.h"
+#include "gjk.h"
+#include "parallel.h"
+
+namespace {
+
+// 분할 비용에 더하는 좌우 부피 차이의 비중
+const float balanceWeight = 0.05f;
+
+struct VoxelGrid {
+    glm::vec3 origin;
+    float cellSize = 0.0f;
+    int size[3] = { 0, 0, 0 };
+    std::vector<uint8_t> solid;
+
+    int index(int x, int y, int z) const { return x + size[0] * (y + size[1] * z); }
+    glm::ivec3 coord(int i) const {
+        return glm::ivec3(i % size[0], (i / size[0]) % size[1], i / (size[0] * size[1]));
+    }
+};
+
+struct Part {
+    std::vector<int> cells;
+    glm::ivec3 min, max;  // cell 좌표 범위 (max 포함)
+    IndexedMesh hull;
+    float concavity = 0.0f;  // hull 부피 - voxel 부피 (cell 부피 단위)
+};
+
+struct Split {
+    int axis = -1;
+    int plane = 0;  // coord[axis] < plane 이면 왼쪽
+    float cost = FLT_MAX;
+};
+
+void collectTriangles(const OctreeNode* node, std::vector<const Triangle*>& triangles) {
+    if (node->isLeaf()) {
+        for (const auto& triangle : node->triangles) {
+            triangles.push_back(&triangle);
+        }
+        return;
+    }
+    for (int i = 0; i < 8; ++i) {
+        if (node->children[i]) {
+            collectTriangles(node->children[i], triangles);
+        }
+    }
+}
+
+VoxelGrid voxelize(const OctreeNode* tree, int resolution) {
+    VoxelGrid grid;
+    glm::vec3 extent = tree->bounds.max - tree->bounds.min;
+    grid.cellSize = std::max(std::max(extent.x, extent.y), extent.z) / resolution;
+    if (!(grid.cellSize > 0.0f)) return grid;
+
+    for (int i = 0; i < 3; ++i) {
+        grid.size[i] = std::max(1, static_cast<int>(std::ceil(extent[i] / grid.cellSize)));
+    }
+    glm::vec3 gridExtent = glm::vec3(grid.size[0], grid.size[1], grid.size[2]) * grid.cellSize;
+    grid.origin = calculateCenter(tree->bounds) - gridExtent * 0.5f;
+    grid.solid.assign(static_cast<size_t>(grid.size[0]) * grid.size[1] * grid.size[2], 0);
+
+    // 표면이 지나는 cell. 삼각형은 여러 leaf 에 복사되어 있지만 같은 cell 을 다시 표시할 뿐이다
+    std::vector<const Triangle*> triangles;
+    collectTriangles(tree, triangles);
+
+    std::vector<std::vector<int>> surface(getWorkerCount());
+    parallelFor(triangles.size(), 256, [&](size_t begin, size_t end, unsigned worker) {
+        for (size_t t = begin; t < end; ++t) {
+            const glm::vec3* v = triangles[t]->vertices;
+            glm::vec3 lo = (glm::min(glm::min(v[0], v[1]), v[2]) - grid.origin) / grid.cellSize;
+            glm::vec3 hi = (glm::max(glm::max(v[0], v[1]), v[2]) - grid.origin) / grid.cellSize;
+            glm::ivec3 first, last;
+            for (int i = 0; i < 3; ++i) {
+                first[i] = glm::clamp(static_cast<int>(std::floor(lo[i])), 0, grid.size[i] - 1);
+                last[i] = glm::clamp(static_cast<int>(std::floor(hi[i])), 0, grid.size[i] - 1);
+            }
+
+            for (int z = first.z; z <= last.z; ++z) {
+                for (int y = first.y; y <= last.y; ++y) {
+                    for (int x = first.x; x <= last.x; ++x) {
+                        AABB cell;
+                        cell.min = grid.origin + glm::vec3(x, y, z) * grid.cellSize;
+                        cell.max = cell.min + glm::vec3(grid.cellSize);
+                        if (checkTriangleAABBCollision(v, cell)) {
+                            surface[worker].push_back(grid.index(x, y, z));
+                        }
+                    }
+                }
+            }
+        }
+    });
+    for (const auto& cells : surface) {
+        for (int cell : cells) {
+            grid.solid[cell] = 1;
+        }
+    }
+
+    // 나머지 cell 은 중심이 mesh 안에 있으면 채운다
+    std::vector<int> candidates;
+    std::vector<glm::vec3> centers;
+    for (size_t i = 0; i < grid.solid.size(); ++i) {
+        if (grid.solid[i]) continue;
+        glm::ivec3 c = grid.coord(static_cast<int>(i));
+        candidates.push_back(static_cast<int>(i));
+        centers.push_back(grid.origin + (glm::vec3(c) + 0.5f) * grid.cellSize);
+    }
+
+    std::vector<uint64_t> inside;
+    containsPoints(tree, centers, inside);
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (testMaskBit(inside, i)) {
+            grid.solid[candidates[i]] = 1;
+        }
+    }
+    return grid;
+}
+
+float computeVolume(const IndexedMesh& mesh) {
+    if (mesh.vertices.empty()) return 0.0f;
+
+    const glm::vec3& origin = mesh.vertices[0];
+    double volume = 0.0;
+    for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+        glm::vec3 a = mesh.vertices[mesh.indices[i]] - origin;
+        glm::vec3 b = mesh.vertices[mesh.indices[i + 1]] - origin;
+        glm::vec3 c = mesh.vertices[mesh.indices[i + 2]] - origin;
+        volume += glm::dot(a, glm::cross(b, c));
+    }
+    return static_cast<float>(volume / 6.0);
+}
+
+void computeRange(const VoxelGrid& grid, const std::vector<int>& cells, glm::ivec3& min, glm::ivec3& max) {
+    min = glm::ivec3(INT_MAX);
+    max = glm::ivec3(INT_MIN);
+    for (int cell : cells) {
+        glm::ivec3 c = grid.coord(cell);
+        min = glm::min(min, c);
+        max = glm::max(max, c);
+    }
+}
+
+// cell 꼭짓점의 볼록 껍질. 가장 긴 축 방향의 한 줄(column)에서는 양 끝 cell 의 꼭짓점만 있으면 된다
+IndexedMesh computeCellHull(const VoxelGrid& grid, const std::vector<int>& cells,
+    const glm::ivec3& min, const glm::ivec3& max) {
+    glm::ivec3 extent = max - min + 1;
+    int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+    int u = (axis + 1) % 3;
+    int v = (axis + 2) % 3;
+
+    thread_local std::vector<glm::ivec2> columns;
+    thread_local std::vector<glm::vec3> points;
+    columns.assign(static_cast<size_t>(extent[u]) * extent[v], glm::ivec2(INT_MAX, INT_MIN));
+    for (int cell : cells) {
+        glm::ivec3 c = grid.coord(cell) - min;
+        glm::ivec2& column = columns[c[u] + extent[u] * c[v]];
+        column.x = std::min(column.x, c[axis]);
+        column.y = std::max(column.y, c[axis]);
+    }
+
+    points.clear();
+    for (int cv = 0; cv < extent[v]; ++cv) {
+        for (int cu = 0; cu < extent[u]; ++cu) {
+            const glm::ivec2& column = columns[cu + extent[u] * cv];
+            if (column.x > column.y) continue;
+
+            int ends[2] = { column.x, column.y + 1 };
+            for (int end : ends) {
+                for (int corner = 0; corner < 4; ++corner) {
+                    glm::ivec3 q;
+                    q[axis] = min[axis] + end;
+                    q[u] = min[u] + cu + (corner & 1);
+                    q[v] = min[v] + cv + (corner >> 1);
+                    points.push_back(grid.origin + glm::vec3(q) * grid.cellSize);
+                }
+            }
+        }
+    }
+    return computeConvexHull(points);
+}
+
+float computeConcavity(const VoxelGrid& grid, const IndexedMesh& hull, size_t cellCount) {
+    float cellVolume = grid.cellSize * grid.cellSize * grid.cellSize;
+    return std::max(0.0f, computeVolume(hull) / cellVolume - static_cast<float>(cellCount));
+}
+
+Part makePart(const VoxelGrid& grid, std::vector<int>&& cells) {
+    Part part;
+    part.cells = std::move(cells);
+    computeRange(grid, part.cells, part.min, part.max);
+    part.hull = computeCellHull(grid, part.cells, part.min, part.max);
+    part.concavity = computeConcavity(grid, part.hull, part.cells.size());
+    return part;
+}
+
+// 6-이웃으로 이어진 덩어리로 나눈다. marks 는 grid 크기이고 호출마다 stamp 를 두 개 쓴다
+std::vector<std::vector<int>> splitComponents(const VoxelGrid& grid, const std::vector<int>& cells,
+    std::vector<int>& marks, int& stamp) {
+    int member = ++stamp;
+    int visited = ++stamp;
+    for (int cell : cells) {
+        marks[cell] = member;
+    }
+
+    std::vector<std::vector<int>> components;
+    std::vector<int> queue;
+    for (int seed : cells) {
+        if (marks[seed] != member) continue;
+
+        components.emplace_back();
+        std::vector<int>& component = components.back();
+        queue.assign(1, seed);
+        marks[seed] = visited;
+        while (!queue.empty()) {
+            int cell = queue.back();
+            queue.pop_back();
+            component.push_back(cell);
+
+            glm::ivec3 c = grid.coord(cell);
+            for (int axis = 0; axis < 3; ++axis) {
+                for (int step = -1; step <= 1; step += 2) {
+                    glm::ivec3 n = c;
+                    n[axis] += step;
+                    if (n[axis] < 0 || n[axis] >= grid.size[axis]) continue;
+                    int neighbor = grid.index(n.x, n.y, n.z);
+                    if (marks[neighbor] == member) {
+                        marks[neighbor] = visited;
+                        queue.push_back(neighbor);
+                    }
+                }
+            }
+        }
+    }
+    return components;
+}
+
+void divideCells(const VoxelGrid& grid, const std::vector<int>& cells, int axis, int plane,
+    std::vector<int>& left, std::vector<int>& right) {
+    left.clear();
+    right.clear();
+    for (int cell : cells) {
+        (grid.coord(cell)[axis] < plane ? left : right).push_back(cell);
+    }
+}
+
+Split findBestSplit(const VoxelGrid& grid, const Part& part, const ConvexDecompositionParams& params, size_t totalCells) {
+    std::vector<Split> candidates;
+    for (int axis = 0; axis < 3; ++axis) {
+        int extent = part.max[axis] - part.min[axis] + 1;
+        if (extent < 2) continue;
+        int step = std::max(1, extent / std::max(params.planeSamples, 1));
+        for (int plane = part.min[axis] + step; plane <= part.max[axis]; plane += step) {
+            Split split;
+            split.axis = axis;
+            split.plane = plane;
+            candidates.push_back(split);
+        }
+    }
+
+    parallelFor(candidates.size(), 1, [&](size_t begin, size_t end, unsigned) {
+        thread_local std::vector<int> left;
+        thread_local std::vector<int> right;
+        for (size_t i = begin; i < end; ++i) {
+            Split& split = candidates[i];
+            divideCells(grid, part.cells, split.axis, split.plane, left, right);
+            if (left.empty() || right.empty()) continue;
+
+            float cost = 0.0f;
+            for (const std::vector<int>* side : { &left, &right }) {
+                glm::ivec3 min, max;
+                computeRange(grid, *side, min, max);
+                cost += computeConcavity(grid, computeCellHull(grid, *side, min, max), side->size());
+            }
+            float imbalance = std::abs(static_cast<float>(left.size()) - static_cast<float>(right.size()));
+            split.cost = (cost + balanceWeight * imbalance) / static_cast<float>(totalCells);
+        }
+    });
+
+    Split best;
+    for (const auto& split : candidates) {
+        if (split.cost < best.cost) {
+            best = split;
+        }
+    }
+    return best;
+}
+
+int buildNode(ConvexCompound& compound, std::vector<int>& order, size_t begin, size_t end) {
+    int index = static_cast<int>(compound.nodes.size());
+    compound.nodes.emplace_back();
+
+    AABB box = compound.hulls[order[begin]].bounds;
+    AABB centers = { calculateCenter(box), calculateCenter(box) };
+    for (size_t i = begin + 1; i < end; ++i) {
+        const AABB& bounds = compound.hulls[order[i]].bounds;
+        box = mergeAABB(box, bounds);
+        centers.min = glm::min(centers.min, calculateCenter(bounds));
+        centers.max = glm::max(centers.max, calculateCenter(bounds));
+    }
+    compound.nodes[index].box = box;
+
+    if (end - begin == 1) {
+        compound.nodes[index].hull = order[begin];
+        return index;
+    }
+
+    glm::vec3 spread = centers.max - centers.min;
+    int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : (spread.y >= spread.z ? 1 : 2);
+    size_t mid = (begin + end) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](int l, int r) {
+        return calculateCenter(compound.hulls[l].bounds)[axis] < calculateCenter(compound.hulls[r].bounds)[axis];
+    });
+
+    int left = buildNode(compound, order, begin, mid);
+    int right = buildNode(compound, order, mid, end);
+    compound.nodes[index].children[0] = left;
+    compound.nodes[index].children[1] = right;
+    return index;
+}
+
+}
+
+ConvexCompound decomposeConvex(const OctreeNode* tree, const ConvexDecompositionParams& params) {
+    ConvexCompound compound;
+    if (!tree) return compound;
+
+    VoxelGrid grid = voxelize(tree, std::max(params.resolution, 1));
+    std::vector<int> cells;
+    for (size_t i = 0; i < grid.solid.size(); ++i) {
+        if (grid.solid[i]) {
+            cells.push_back(static_cast<int>(i));
+        }
+    }
+    if (cells.empty()) return compound;
+
+    size_t totalCells = cells.size();
+    size_t maxHulls = static_cast<size_t>(std::max(params.maxHulls, 1));
+    float threshold = params.concavity * static_cast<float>(totalCells);
+    std::vector<int> marks(grid.solid.size(), 0);
+    int stamp = 0;
+
+    // 떨어진 덩어리는 처음부터 따로 둔다 (개수 제한 안에서만)
+    std::vector<Part> parts;
+    std::vector<std::vector<int>> components = splitComponents(grid, cells, marks, stamp);
+    if (components.size() <= maxHulls) {
+        for (auto& component : components) {
+            parts.push_back(makePart(grid, std::move(component)));
+        }
+    }
+    else {
+        parts.push_back(makePart(grid, std::move(cells)));
+    }
+
+    std::vector<int> left, right;
+    while (parts.size() < maxHulls) {
+        size_t worst = 0;
+        for (size_t i = 1; i < parts.size(); ++i) {
+            if (parts[i].concavity > parts[worst].concavity) {
+                worst = i;
+            }
+        }
+        if (parts[worst].concavity <= threshold) break;
+
+        Split split = findBestSplit(grid, parts[worst], params, totalCells);
+        if (split.axis < 0) {
+            parts[worst].concavity = 0.0f;
+            continue;
+        }
+
+        Part part = std::move(parts[worst]);
+        parts[worst] = std::move(parts.back());
+        parts.pop_back();
+        divideCells(grid, part.cells, split.axis, split.plane, left, right);
+
+        // 평면으로 자른 쪽이 여러 덩어리로 나뉘면 개수 제한 안에서 각각 따로 둔다
+        size_t budget = maxHulls - parts.size();
+        std::vector<std::vector<int>> leftParts = splitComponents(grid, left, marks, stamp);
+        std::vector<std::vector<int>> rightParts = splitComponents(grid, right, marks, stamp);
+        if (leftParts.size() + rightParts.size() <= budget) {
+            for (auto* sides : { &leftParts, &rightParts }) {
+                for (auto& component : *sides) {
+                    parts.push_back(makePart(grid, std::move(component)));
+                }
+            }
+        }
+        else {
+            parts.push_back(makePart(grid, std::move(left)));
+            parts.push_back(makePart(grid, std::move(right)));
+        }
+    }
+
+    std::vector<int> order;
+    for (auto& part : parts) {
+        if (part.hull.vertices.empty()) continue;
+        order.push_back(static_cast<int>(compound.hulls.size()));
+        compound.hulls.push_back(std::move(part.hull));
+    }
+    if (compound.hulls.empty()) return compound;
+
+    compound.nodes.reserve(compound.hulls.size() * 2);
+    buildNode(compound, order, 0, order.size());
+    compound.bounds = compound.nodes[0].box;
+    return compound;
+}
+
+bool collideCompounds(const ConvexCompound& a, const ConvexCompound& b, const glm::mat4& bToA) {
+    if (a.nodes.empty() || b.nodes.empty()) return false;
+
+    thread_local std::vector<std::pair<int, int>> stack;
+    stack.clear();
+    stack.emplace_back(0, 0);
+    while (!stack.empty()) {
+        std::pair<int, int> pair = stack.back();
+        stack.pop_back();
+
+        const CompoundNode& nodeA = a.nodes[pair.first];
+        const CompoundNode& nodeB = b.nodes[pair.second];
+        AABB boxB = transformAABB(nodeB.box, bToA);
+        if (!checkAABBCollision(nodeA.box, boxB)) continue;
+
+        if (nodeA.isLeaf() && nodeB.isLeaf()) {
+            if (gjkIntersect(a.hulls[nodeA.hull], b.hulls[nodeB.hull], bToA)) {
+                return true;
+            }
+            continue;
+        }
+
+        // leaf 가 아니면서 더 큰 쪽을 내려간다
+        glm::vec3 sizeA = nodeA.box.max - nodeA.box.min;
+        glm::vec3 sizeB = boxB.max - boxB.min;
+        bool descendA = nodeB.isLeaf() || (!nodeA.isLeaf() && glm::dot(sizeA, sizeA) >= glm::dot(sizeB, sizeB));
+        if (descendA) {
+            stack.emplace_back(nodeA.children[0], pair.second);
+            stack.emplace_back(nodeA.children[1], pair.second);
+        }
+        else {
+            stack.emplace_back(pair.first, nodeB.children[0]);
+            stack.emplace_back(pair.first, nodeB.children[1]);
+        }
+    }
+    return false;
+}
+
+void collideCompoundBatch(const ConvexCompound& a, const ConvexCompound& b, const glm::mat4* poses, size_t poseCount,
+    std::vector<uint64_t>& results) {
+    results.assign((poseCount + 63) / 64, 0);
+    parallelFor(poseCount, 64, [&](size_t begin, size_t end, unsigned) {
+        uint64_t word = 0;
+        for (size_t i = begin; i < end; ++i) {
+            if (collideCompounds(a, b, poses[i])) {
+                word |= 1ull << (i & 63);
+            }
+        }
+        results[begin / 64] = word;
+    });
+}
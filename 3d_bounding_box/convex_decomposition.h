@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm/glm.hpp>
+#include "geometry.h"
+#include "mesh.h"
+#include "octree.h"
+
+struct ConvexDecompositionParams {
+    int resolution = 40;      // 가장 긴 축의 voxel 수
+    int maxHulls = 32;
+    float concavity = 0.01f;  // (hull 부피 - voxel 부피) / 전체 voxel 부피 가 이 값 이하이면 더 나누지 않는다
+    int planeSamples = 12;    // 축마다 시험하는 분할 평면 수
+};
+
+// hull 들의 bounds 로 만든 이진 트리. leaf 는 hull 하나를 가진다
+struct CompoundNode {
+    AABB box;
+    int children[2] = { -1, -1 };
+    int hull = -1;
+
+    bool isLeaf() const { return hull >= 0; }
+};
+
+// 볼록 껍질 여러 개로 mesh 를 근사한 compound. nodes[0] 이 root
+struct ConvexCompound {
+    std::vector<IndexedMesh> hulls;
+    std::vector<CompoundNode> nodes;
+    AABB bounds;
+};
+
+// V-HACD 와 비슷한 근사 볼록 분해. tree 를 voxel 로 채운 뒤(표면 cell + 안쪽 cell) concavity 가 가장 큰
+// 조각을 축 평면으로 나누기를 반복한다. 분할 평면 후보의 hull 계산을 스레드에 나눈다.
+// hull 은 voxel 꼭짓점으로 만들므로 원래 mesh 를 cell 크기 안에서 보수적으로 덮는다
+ConvexCompound decomposeConvex(const OctreeNode* tree, const ConvexDecompositionParams& params = ConvexDecompositionParams());
+
+// 두 compound 의 트리를 함께 내려가 bounds 가 겹치는 hull 쌍만 GJK 로 검사한다
+bool collideCompounds(const ConvexCompound& a, const ConvexCompound& b, const glm::mat4& bToA);
+
+// 여러 자세를 스레드에 나눠 검사한다. 결과는 pose i 가 bit (i % 64) of results[i / 64]
+void collideCompoundBatch(const ConvexCompound& a, const ConvexCompound& b, const glm::mat4* poses, size_t poseCount,
+    std::vector<uint64_t>& results);
@@ -0,0 +1,258 @@
+﻿#include "convex_hull.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include "parallel.h"
+
+namespace {
+
+struct HullFace {
+    int v[3];
+    glm::vec3 normal;
+    float offset;
+    std::vector<int> outside;  // 이 면 바깥에 있는 점
+    bool alive = true;
+    bool visible = false;
+
+    float distance(const glm::vec3& p) const { return glm::dot(normal, p) - offset; }
+};
+
+inline uint64_t edgeKey(int a, int b) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(a)) << 32) | static_cast<uint32_t>(b);
+}
+
+class Quickhull {
+public:
+    Quickhull(const std::vector<glm::vec3>& points) : points(points) {}
+
+    IndexedMesh run() {
+        IndexedMesh result;
+        if (points.size() < 4 || !buildInitialSimplex()) {
+            return result;
+        }
+
+        // 바깥 점은 새로 만든 면(뒤쪽)에만 생기므로 앞에서부터 한 번만 훑으면 된다
+        for (size_t next = 0; next < faces.size(); ++next) {
+            if (!faces[next].alive || faces[next].outside.empty()) continue;
+
+            // 이 면 바깥에서 가장 먼 점을 hull 에 넣는다
+            int faceIndex = static_cast<int>(next);
+
+            int eye = -1;
+            float farthest = -FLT_MAX;
+            for (int p : faces[faceIndex].outside) {
+                float d = faces[faceIndex].distance(points[p]);
+                if (d > farthest) {
+                    farthest = d;
+                    eye = p;
+                }
+            }
+            addPoint(eye, faceIndex);
+        }
+
+        // 살아 있는 면이 쓰는 꼭짓점만 남긴다
+        std::vector<int> remap(points.size(), -1);
+        for (const auto& face : faces) {
+            if (!face.alive) continue;
+            for (int i = 0; i < 3; ++i) {
+                int& index = remap[face.v[i]];
+                if (index < 0) {
+                    index = static_cast<int>(result.vertices.size());
+                    result.vertices.push_back(points[face.v[i]]);
+                }
+                result.indices.push_back(index);
+            }
+        }
+        result.bounds.min = result.bounds.max = result.vertices[0];
+        for (const auto& v : result.vertices) {
+            result.bounds.min = glm::min(result.bounds.min, v);
+            result.bounds.max = glm::max(result.bounds.max, v);
+        }
+        return result;
+    }
+
+private:
+    bool buildInitialSimplex() {
+        glm::vec3 maxAbs(0.0f);
+        int extremes[6] = { 0, 0, 0, 0, 0, 0 };
+        for (size_t i = 0; i < points.size(); ++i) {
+            const glm::vec3& p = points[i];
+            maxAbs = glm::max(maxAbs, glm::abs(p));
+            for (int axis = 0; axis < 3; ++axis) {
+                if (p[axis] < points[extremes[axis * 2]][axis]) extremes[axis * 2] = static_cast<int>(i);
+                if (p[axis] > points[extremes[axis * 2 + 1]][axis]) extremes[axis * 2 + 1] = static_cast<int>(i);
+            }
+        }
+        epsilon = 3.0f * FLT_EPSILON * (maxAbs.x + maxAbs.y + maxAbs.z);
+
+        // 축 방향 극점 중 가장 먼 두 점
+        int v0 = 0, v1 = 0;
+        float best = 0.0f;
+        for (int i = 0; i < 6; ++i) {
+            for (int j = i + 1; j < 6; ++j) {
+                glm::vec3 d = points[extremes[i]] - points[extremes[j]];
+                if (glm::dot(d, d) > best) {
+                    best = glm::dot(d, d);
+                    v0 = extremes[i];
+                    v1 = extremes[j];
+                }
+            }
+        }
+        if (best <= epsilon * epsilon) return false;
+
+        // 그 직선에서 가장 먼 점
+        int v2 = -1;
+        best = 0.0f;
+        glm::vec3 line = points[v1] - points[v0];
+        for (size_t i = 0; i < points.size(); ++i) {
+            glm::vec3 c = glm::cross(line, points[i] - points[v0]);
+            if (glm::dot(c, c) > best) {
+                best = glm::dot(c, c);
+                v2 = static_cast<int>(i);
+            }
+        }
+        if (v2 < 0) return false;
+
+        // 그 평면에서 가장 먼 점
+        glm::vec3 normal = glm::normalize(glm::cross(line, points[v2] - points[v0]));
+        int v3 = -1;
+        best = epsilon;
+        for (size_t i = 0; i < points.size(); ++i) {
+            float d = std::abs(glm::dot(normal, points[i] - points[v0]));
+            if (d > best) {
+                best = d;
+                v3 = static_cast<int>(i);
+            }
+        }
+        if (v3 < 0) return false;
+
+        // v3 가 면 (v0, v1, v2) 의 뒤쪽에 오도록 방향을 맞춘다
+        if (glm::dot(normal, points[v3] - points[v0]) > 0.0f) {
+            std::swap(v1, v2);
+        }
+        addFace(v0, v1, v2);
+        addFace(v0, v3, v1);
+        addFace(v1, v3, v2);
+        addFace(v2, v3, v0);
+
+        // 점마다 처음으로 바깥에 있는 면을 병렬로 찾고 worker 별로 모은다
+        unsigned workers = getWorkerCount();
+        std::vector<std::vector<int>> buckets(workers * 4);
+        parallelFor(points.size(), 4096, [&](size_t begin, size_t end, unsigned worker) {
+            for (size_t i = begin; i < end; ++i) {
+                for (int f = 0; f < 4; ++f) {
+                    if (faces[f].distance(points[i]) > epsilon) {
+                        buckets[worker * 4 + f].push_back(static_cast<int>(i));
+                        break;
+                    }
+                }
+            }
+        });
+        for (unsigned w = 0; w < workers; ++w) {
+            for (int f = 0; f < 4; ++f) {
+                std::vector<int>& bucket = buckets[w * 4 + f];
+                faces[f].outside.insert(faces[f].outside.end(), bucket.begin(), bucket.end());
+            }
+        }
+        return true;
+    }
+
+    int addFace(int a, int b, int c) {
+        HullFace face;
+        face.v[0] = a;
+        face.v[1] = b;
+        face.v[2] = c;
+        face.normal = glm::normalize(glm::cross(points[b] - points[a], points[c] - points[a]));
+        face.offset = glm::dot(face.normal, points[a]);
+        int index = static_cast<int>(faces.size());
+        faces.push_back(std::move(face));
+        for (int i = 0; i < 3; ++i) {
+            edges[edgeKey(faces[index].v[i], faces[index].v[(i + 1) % 3])] = index;
+        }
+        return index;
+    }
+
+    void removeFace(int index) {
+        HullFace& face = faces[index];
+        face.alive = false;
+        for (int i = 0; i < 3; ++i) {
+            edges.erase(edgeKey(face.v[i], face.v[(i + 1) % 3]));
+        }
+    }
+
+    void addPoint(int eye, int startFace) {
+        const glm::vec3& p = points[eye];
+
+        // eye 에서 보이는 면을 이웃을 따라 찾는다
+        visible.clear();
+        faces[startFace].visible = true;
+        visible.push_back(startFace);
+        for (size_t k = 0; k < visible.size(); ++k) {
+            const HullFace& face = faces[visible[k]];
+            for (int i = 0; i < 3; ++i) {
+                int neighbor = edges[edgeKey(face.v[(i + 1) % 3], face.v[i])];
+                HullFace& other = faces[neighbor];
+                if (!other.visible && other.distance(p) > epsilon) {
+                    other.visible = true;
+                    visible.push_back(neighbor);
+                }
+            }
+        }
+
+        // 보이는 면과 보이지 않는 면 사이의 모서리가 horizon
+        horizon.clear();
+        for (int f : visible) {
+            const HullFace& face = faces[f];
+            for (int i = 0; i < 3; ++i) {
+                int a = face.v[i];
+                int b = face.v[(i + 1) % 3];
+                if (!faces[edges[edgeKey(b, a)]].visible) {
+                    horizon.emplace_back(a, b);
+                }
+            }
+        }
+
+        orphans.clear();
+        for (int f : visible) {
+            std::vector<int>& outside = faces[f].outside;
+            for (int q : outside) {
+                if (q != eye) orphans.push_back(q);
+            }
+            outside.clear();
+            outside.shrink_to_fit();
+            removeFace(f);
+        }
+
+        size_t firstNew = faces.size();
+        for (const auto& edge : horizon) {
+            addFace(edge.first, edge.second, eye);
+        }
+
+        for (int q : orphans) {
+            for (size_t f = firstNew; f < faces.size(); ++f) {
+                if (faces[f].distance(points[q]) > epsilon) {
+                    faces[f].outside.push_back(q);
+                    break;
+                }
+            }
+        }
+    }
+
+    const std::vector<glm::vec3>& points;
+    std::vector<HullFace> faces;
+    std::unordered_map<uint64_t, int> edges;  // 방향 있는 모서리 (a, b) 를 가진 면
+    std::vector<int> visible;
+    std::vector<std::pair<int, int>> horizon;
+    std::vector<int> orphans;
+    float epsilon = 0.0f;
+};
+
+}
+
+IndexedMesh computeConvexHull(const std::vector<glm::vec3>& points) {
+    Quickhull hull(points);
+    return hull.run();
+}
@@ -0,0 +1,11 @@
+﻿#pragma once
+
+#include <vector>
+#include <glm/glm/glm.hpp>
+#include "mesh.h"
+
+// Quickhull. 결과 삼각형은 바깥에서 볼 때 반시계 방향이고 vertices 는 hull 꼭짓점만 담는다.
+// 처음 사면체의 면에 점을 나눠 담는 단계(점 수에 비례하는 대부분의 일)를 스레드에 나눈다.
+// 점이 한 평면 위에 있거나 4개보다 적으면 빈 mesh 를 돌려준다
+IndexedMesh computeConvexHull(const std::vector<glm::vec3>& points);
+inline IndexedMesh computeConvexHull(const IndexedMesh& mesh) { return computeConvexHull(mesh.vertices); }
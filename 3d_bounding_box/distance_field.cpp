@@ -0,0 +1,242 @@
+﻿#include "distance_field.h"
+
+#include <algorithm>
+#include <cmath>
+#include "closest_point.h"
+#include "containment.h"
+#include "parallel.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+const int DistanceField::brickCells;
+const int DistanceField::brickSamples;
+
+void DistanceField::build(const OctreeNode* tree, float cellSize, float narrowBand) {
+    this->cellSize = cellSize;
+    this->narrowBand = narrowBand;
+    bricks.clear();
+    samples.clear();
+    if (!tree) {
+        brickCount = glm::ivec3(0);
+        return;
+    }
+
+    // 표면이 격자 경계에 닿지 않도록 cell 두 개만큼 여유를 둔다
+    glm::vec3 padding(2.0f * cellSize);
+    glm::vec3 extent = tree->bounds.max - tree->bounds.min + 2.0f * padding;
+    glm::ivec3 cellCount = glm::max(glm::ivec3(glm::ceil(extent / cellSize)), glm::ivec3(1));
+    brickCount = (cellCount + brickCells - 1) / brickCells;
+    bounds.min = tree->bounds.min - padding;
+    bounds.max = bounds.min + glm::vec3(brickCount * brickCells) * cellSize;
+
+    size_t total = static_cast<size_t>(brickCount.x) * brickCount.y * brickCount.z;
+    bricks.resize(total);
+
+    // brick 중심의 거리로 표면과 가까운 brick 을 고른다. 중심 거리가 반대각선보다 크면
+    // brick 안에 표면이 없으므로 부호가 하나로 정해진다
+    const float brickSize = brickCells * cellSize;
+    const float halfDiagonal = 0.5f * std::sqrt(3.0f) * brickSize;
+    std::vector<float> centerDistance(total);
+    auto brickMin = [&](size_t index) {
+        glm::ivec3 b(static_cast<int>(index % brickCount.x),
+            static_cast<int>(index / brickCount.x % brickCount.y),
+            static_cast<int>(index / (static_cast<size_t>(brickCount.x) * brickCount.y)));
+        return bounds.min + glm::vec3(b) * brickSize;
+    };
+
+    parallelFor(total, 1, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; ++i) {
+            glm::vec3 center = brickMin(i) + glm::vec3(0.5f * brickSize);
+            float distance = closestPoint(tree, center).distance;
+            centerDistance[i] = containsPoint(tree, center) ? -distance : distance;
+        }
+    });
+
+    const size_t samplesPerBrick = brickSamples * brickSamples * brickSamples;
+    size_t allocated = 0;
+    for (size_t i = 0; i < total; ++i) {
+        float distance = std::abs(centerDistance[i]);
+        if (distance <= halfDiagonal + narrowBand) {
+            bricks[i].offset = static_cast<int>(allocated * samplesPerBrick);
+            ++allocated;
+        }
+        else {
+            bricks[i].offset = -1;
+        }
+        bricks[i].distance = std::copysign(std::max(distance - halfDiagonal, 0.0f), centerDistance[i]);
+    }
+    samples.resize(allocated * samplesPerBrick);
+
+    parallelFor(total, 1, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; ++i) {
+            if (bricks[i].offset < 0) continue;
+
+            float center = centerDistance[i];
+            bool crossesSurface = std::abs(center) <= halfDiagonal;
+            // brick 안 점까지의 거리는 |중심 거리| + 반대각선을 넘지 않는다
+            float searchDistance = (std::abs(center) + halfDiagonal) * 1.001f + cellSize;
+
+            glm::vec3 origin = brickMin(i);
+            float* out = &samples[bricks[i].offset];
+            for (int z = 0; z < brickSamples; ++z) {
+                for (int y = 0; y < brickSamples; ++y) {
+                    for (int x = 0; x < brickSamples; ++x) {
+                        glm::vec3 p = origin + glm::vec3(x, y, z) * cellSize;
+                        float distance = closestPoint(tree, p, searchDistance).distance;
+                        bool inside = crossesSurface ? containsPoint(tree, p) : center < 0.0f;
+                        *out++ = inside ? -distance : distance;
+                    }
+                }
+            }
+        }
+    });
+}
+
+float DistanceField::sampleInside(const glm::vec3& p) const {
+    glm::vec3 cell = (p - bounds.min) / cellSize;
+    glm::ivec3 brick = glm::clamp(glm::ivec3(glm::floor(cell / float(brickCells))), glm::ivec3(0), brickCount - 1);
+    const Brick& b = bricks[(static_cast<size_t>(brick.z) * brickCount.y + brick.y) * brickCount.x + brick.x];
+    if (b.offset < 0) {
+        return b.distance;
+    }
+
+    glm::vec3 local = glm::clamp(cell - glm::vec3(brick * brickCells), glm::vec3(0.0f), glm::vec3(brickCells));
+    glm::ivec3 i0 = glm::min(glm::ivec3(local), glm::ivec3(brickCells - 1));
+    glm::vec3 f = local - glm::vec3(i0);
+
+    const float* s = &samples[b.offset + (i0.z * brickSamples + i0.y) * brickSamples + i0.x];
+    const int dy = brickSamples;
+    const int dz = brickSamples * brickSamples;
+    float c00 = s[0] + (s[1] - s[0]) * f.x;
+    float c10 = s[dy] + (s[dy + 1] - s[dy]) * f.x;
+    float c01 = s[dz] + (s[dz + 1] - s[dz]) * f.x;
+    float c11 = s[dz + dy] + (s[dz + dy + 1] - s[dz + dy]) * f.x;
+    float c0 = c00 + (c10 - c00) * f.y;
+    float c1 = c01 + (c11 - c01) * f.y;
+    return c0 + (c1 - c0) * f.z;
+}
+
+float DistanceField::sample(const glm::vec3& p) const {
+    if (bricks.empty()) {
+        return std::numeric_limits<float>::max();
+    }
+
+    // 격자 밖이면 mesh 바깥이다. 거리는 격자 경계까지의 거리 이상이고,
+    // 경계 점의 거리에서 경계까지의 거리를 뺀 값 이상이다
+    glm::vec3 clamped = glm::clamp(p, bounds.min, bounds.max);
+    if (clamped == p) {
+        return sampleInside(p);
+    }
+    float outside = glm::length(p - clamped);
+    return std::max(outside, sampleInside(clamped) - outside);
+}
+
+void DistanceField::sample(const glm::vec3* points, size_t count, float* distances) const {
+    sample(points, count, glm::mat4(1.0f), distances);
+}
+
+void DistanceField::sample(const glm::vec3* points, size_t count, const glm::mat4& transform, float* distances) const {
+    size_t i = 0;
+#if defined(__AVX2__)
+    static_assert(sizeof(Brick) == 8, "Brick gather uses an 8 byte stride");
+    if (!bricks.empty()) {
+        const __m256 minX = _mm256_set1_ps(bounds.min.x), minY = _mm256_set1_ps(bounds.min.y), minZ = _mm256_set1_ps(bounds.min.z);
+        const __m256 maxX = _mm256_set1_ps(bounds.max.x), maxY = _mm256_set1_ps(bounds.max.y), maxZ = _mm256_set1_ps(bounds.max.z);
+        const __m256 invCell = _mm256_set1_ps(1.0f / cellSize);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 cellsPerBrick = _mm256_set1_ps(static_cast<float>(brickCells));
+        const __m256 invCellsPerBrick = _mm256_set1_ps(1.0f / brickCells);
+        const __m256i lastCell = _mm256_set1_epi32(brickCells - 1);
+        const __m256i zeroInt = _mm256_setzero_si256();
+        const __m256i lastBrickX = _mm256_set1_epi32(brickCount.x - 1);
+        const __m256i lastBrickY = _mm256_set1_epi32(brickCount.y - 1);
+        const __m256i lastBrickZ = _mm256_set1_epi32(brickCount.z - 1);
+        const __m256i strideY = _mm256_set1_epi32(brickCount.x);
+        const __m256i strideZ = _mm256_set1_epi32(brickCount.x * brickCount.y);
+        const __m256i sampleStrideY = _mm256_set1_epi32(brickSamples);
+        const __m256i sampleStrideZ = _mm256_set1_epi32(brickSamples * brickSamples);
+        const __m256i xyz = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+        const int* brickOffsets = &bricks[0].offset;
+        const float* brickDistances = &bricks[0].distance;
+        const float* s = samples.empty() ? nullptr : samples.data();
+        __m256 m[4][3];
+        for (int c = 0; c < 4; ++c) {
+            for (int r = 0; r < 3; ++r) {
+                m[c][r] = _mm256_set1_ps(transform[c][r]);
+            }
+        }
+
+        for (; i + 8 <= count; i += 8) {
+            const float* base = &points[i].x;
+            __m256 lx = _mm256_i32gather_ps(base, xyz, 4);
+            __m256 ly = _mm256_i32gather_ps(base + 1, xyz, 4);
+            __m256 lz = _mm256_i32gather_ps(base + 2, xyz, 4);
+            __m256 px = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[0][0], lx), _mm256_mul_ps(m[1][0], ly)), _mm256_add_ps(_mm256_mul_ps(m[2][0], lz), m[3][0]));
+            __m256 py = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[0][1], lx), _mm256_mul_ps(m[1][1], ly)), _mm256_add_ps(_mm256_mul_ps(m[2][1], lz), m[3][1]));
+            __m256 pz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[0][2], lx), _mm256_mul_ps(m[1][2], ly)), _mm256_add_ps(_mm256_mul_ps(m[2][2], lz), m[3][2]));
+
+            // 격자 밖 점은 경계로 옮기고 옮긴 거리를 기억한다
+            __m256 cx = _mm256_min_ps(_mm256_max_ps(px, minX), maxX);
+            __m256 cy = _mm256_min_ps(_mm256_max_ps(py, minY), maxY);
+            __m256 cz = _mm256_min_ps(_mm256_max_ps(pz, minZ), maxZ);
+            __m256 ox = _mm256_sub_ps(px, cx), oy = _mm256_sub_ps(py, cy), oz = _mm256_sub_ps(pz, cz);
+            __m256 outside = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ox, ox), _mm256_mul_ps(oy, oy)), _mm256_mul_ps(oz, oz)));
+
+            __m256 cellX = _mm256_mul_ps(_mm256_sub_ps(cx, minX), invCell);
+            __m256 cellY = _mm256_mul_ps(_mm256_sub_ps(cy, minY), invCell);
+            __m256 cellZ = _mm256_mul_ps(_mm256_sub_ps(cz, minZ), invCell);
+
+            __m256i bx = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(cellX, invCellsPerBrick))), zeroInt), lastBrickX);
+            __m256i by = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(cellY, invCellsPerBrick))), zeroInt), lastBrickY);
+            __m256i bz = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(cellZ, invCellsPerBrick))), zeroInt), lastBrickZ);
+            __m256i brick = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(bz, strideZ), _mm256_mullo_epi32(by, strideY)), bx);
+
+            __m256i offset = _mm256_i32gather_epi32(brickOffsets, brick, 8);
+            __m256 brickDistance = _mm256_i32gather_ps(brickDistances, brick, 8);
+            __m256 hasSamples = _mm256_castsi256_ps(_mm256_cmpgt_epi32(offset, _mm256_set1_epi32(-1)));
+
+            __m256 localX = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(cellX, _mm256_mul_ps(_mm256_cvtepi32_ps(bx), cellsPerBrick)), zero), cellsPerBrick);
+            __m256 localY = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(cellY, _mm256_mul_ps(_mm256_cvtepi32_ps(by), cellsPerBrick)), zero), cellsPerBrick);
+            __m256 localZ = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(cellZ, _mm256_mul_ps(_mm256_cvtepi32_ps(bz), cellsPerBrick)), zero), cellsPerBrick);
+            __m256i ix = _mm256_min_epi32(_mm256_cvttps_epi32(localX), lastCell);
+            __m256i iy = _mm256_min_epi32(_mm256_cvttps_epi32(localY), lastCell);
+            __m256i iz = _mm256_min_epi32(_mm256_cvttps_epi32(localZ), lastCell);
+            __m256 fx = _mm256_sub_ps(localX, _mm256_cvtepi32_ps(ix));
+            __m256 fy = _mm256_sub_ps(localY, _mm256_cvtepi32_ps(iy));
+            __m256 fz = _mm256_sub_ps(localZ, _mm256_cvtepi32_ps(iz));
+
+            // 표본이 없는 brick 의 lane 은 gather 하지 않는다
+            __m256i index = _mm256_add_epi32(offset, _mm256_add_epi32(
+                _mm256_add_epi32(_mm256_mullo_epi32(iz, sampleStrideZ), _mm256_mullo_epi32(iy, sampleStrideY)), ix));
+            auto gather = [&](int delta) {
+                return _mm256_mask_i32gather_ps(zero, s, _mm256_add_epi32(index, _mm256_set1_epi32(delta)), hasSamples, 4);
+            };
+            auto lerp = [](__m256 a, __m256 b, __m256 t) {
+                return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t));
+            };
+            const int dy = brickSamples;
+            const int dz = brickSamples * brickSamples;
+            __m256 s000 = gather(0), s100 = gather(1), s010 = gather(dy), s110 = gather(dy + 1);
+            __m256 s001 = gather(dz), s101 = gather(dz + 1), s011 = gather(dz + dy), s111 = gather(dz + dy + 1);
+
+            __m256 c00 = lerp(s000, s100, fx);
+            __m256 c10 = lerp(s010, s110, fx);
+            __m256 c01 = lerp(s001, s101, fx);
+            __m256 c11 = lerp(s011, s111, fx);
+            __m256 c0 = lerp(c00, c10, fy);
+            __m256 c1 = lerp(c01, c11, fy);
+            __m256 value = lerp(c0, c1, fz);
+            value = _mm256_blendv_ps(brickDistance, value, hasSamples);
+
+            __m256 isOutside = _mm256_cmp_ps(outside, zero, _CMP_GT_OQ);
+            __m256 outsideValue = _mm256_max_ps(outside, _mm256_sub_ps(value, outside));
+            _mm256_storeu_ps(distances + i, _mm256_blendv_ps(value, outsideValue, isOutside));
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        distances[i] = sample(glm::vec3(transform * glm::vec4(points[i], 1.0f)));
+    }
+}
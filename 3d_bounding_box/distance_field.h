@@ -0,0 +1,49 @@
+﻿#pragma once
+
+#include <limits>
+#include <vector>
+#include <glm/glm/glm.hpp>
+#include "geometry.h"
+#include "octree.h"
+
+// mesh 의 signed distance 를 격자에 저장한다. 안쪽이 음수.
+// 격자는 brickCells^3 cell 단위 brick 으로 나뉘고, brick 마다 (brickCells + 1)^3 개의 표본을
+// 경계까지 따로 가지므로 trilinear 보간이 brick 하나 안에서 끝난다.
+// 표면에서 narrowBand 보다 먼 brick 은 표본 없이 값 하나(그 brick 안의 |거리| 하한)만 둔다.
+class DistanceField {
+public:
+    static const int brickCells = 8;
+    static const int brickSamples = brickCells + 1;
+
+    // narrowBand 가 float 최댓값이면 모든 brick 에 표본을 둔 dense 격자
+    void build(const OctreeNode* tree, float cellSize,
+        float narrowBand = std::numeric_limits<float>::max());
+
+    // trilinear 보간 값. 표본이 없는 brick 과 격자 밖에서는 실제 거리보다 작은 |값| 을 돌려준다
+    float sample(const glm::vec3& p) const;
+    // 여러 점을 한 번에 보간한다. AVX2 가 있으면 8개씩 gather 로 처리.
+    // transform 이 있으면 점을 transform 으로 옮긴 위치의 값 (옮긴 좌표를 따로 저장하지 않는다)
+    void sample(const glm::vec3* points, size_t count, float* distances) const;
+    void sample(const glm::vec3* points, size_t count, const glm::mat4& transform, float* distances) const;
+
+    const AABB& getBounds() const { return bounds; }
+    float getCellSize() const { return cellSize; }
+    float getNarrowBand() const { return narrowBand; }
+    size_t getBrickCount() const { return bricks.size(); }
+    size_t getAllocatedBrickCount() const { return samples.size() / (brickSamples * brickSamples * brickSamples); }
+
+private:
+    struct Brick {
+        int offset;      // samples 에서의 시작 위치, 표본이 없으면 -1
+        float distance;  // 표본이 없을 때 쓰는 값
+    };
+
+    float sampleInside(const glm::vec3& p) const;
+
+    AABB bounds;
+    float cellSize = 1.0f;
+    float narrowBand = 0.0f;
+    glm::ivec3 brickCount = glm::ivec3(0);
+    std::vector<Brick> bricks;
+    std::vector<float> samples;
+};
@@ -0,0 +1,322 @@
+﻿#include "dynamic_aabb_tree.h"
+
+#include <algorithm>
+#include <utility>
+
+const int DynamicAABBTree::nullNode;
+
+namespace {
+
+float perimeter(const AABB& box) {
+    glm::vec3 d = box.max - box.min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+bool containsAABB(const AABB& outer, const AABB& inner) {
+    return glm::all(glm::lessThanEqual(outer.min, inner.min)) &&
+        glm::all(glm::greaterThanEqual(outer.max, inner.max));
+}
+
+}
+
+DynamicAABBTree::DynamicAABBTree(float fatMargin) : fatMargin(fatMargin) {
+}
+
+int DynamicAABBTree::allocateNode() {
+    if (freeList == nullNode) {
+        nodes.emplace_back();
+        return static_cast<int>(nodes.size()) - 1;
+    }
+
+    int node = freeList;
+    freeList = nodes[node].parent;
+    nodes[node] = Node();
+    return node;
+}
+
+void DynamicAABBTree::freeNode(int node) {
+    nodes[node] = Node();
+    nodes[node].parent = freeList;
+    freeList = node;
+}
+
+int DynamicAABBTree::createProxy(const AABB& box, int userData) {
+    int proxy = allocateNode();
+    Node& node = nodes[proxy];
+    node.box.min = box.min - glm::vec3(fatMargin);
+    node.box.max = box.max + glm::vec3(fatMargin);
+    node.userData = userData;
+    node.height = 0;
+
+    insertLeaf(proxy);
+    markMoved(proxy);
+    return proxy;
+}
+
+void DynamicAABBTree::destroyProxy(int proxy) {
+    removeLeaf(proxy);
+    freeNode(proxy);
+    moveBuffer.erase(std::remove(moveBuffer.begin(), moveBuffer.end(), proxy), moveBuffer.end());
+}
+
+bool DynamicAABBTree::moveProxy(int proxy, const AABB& box, const glm::vec3& displacement) {
+    ++stats.proxiesMoved;
+    if (containsAABB(nodes[proxy].box, box)) {
+        return false;
+    }
+
+    removeLeaf(proxy);
+
+    // 이동 방향으로 fat box 를 더 늘려 다음 프레임의 재삽입을 줄인다
+    AABB fat;
+    fat.min = box.min - glm::vec3(fatMargin);
+    fat.max = box.max + glm::vec3(fatMargin);
+    glm::vec3 d = displacement * 2.0f;
+    fat.min += glm::min(d, glm::vec3(0.0f));
+    fat.max += glm::max(d, glm::vec3(0.0f));
+    nodes[proxy].box = fat;
+
+    insertLeaf(proxy);
+    markMoved(proxy);
+    ++stats.proxiesReinserted;
+    return true;
+}
+
+void DynamicAABBTree::markMoved(int proxy) {
+    if (!nodes[proxy].moved) {
+        nodes[proxy].moved = true;
+        moveBuffer.push_back(proxy);
+    }
+}
+
+void DynamicAABBTree::insertLeaf(int leaf) {
+    if (root == nullNode) {
+        root = leaf;
+        nodes[root].parent = nullNode;
+        return;
+    }
+
+    // 표면적 증가량이 가장 작은 sibling 을 찾는다
+    AABB leafBox = nodes[leaf].box;
+    int index = root;
+    while (!nodes[index].isLeaf()) {
+        const Node& node = nodes[index];
+        float area = perimeter(node.box);
+        float combinedArea = perimeter(mergeAABB(node.box, leafBox));
+
+        float cost = 2.0f * combinedArea;
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        float childCost[2];
+        int children[2] = { node.child1, node.child2 };
+        for (int i = 0; i < 2; ++i) {
+            const Node& child = nodes[children[i]];
+            float mergedArea = perimeter(mergeAABB(leafBox, child.box));
+            childCost[i] = child.isLeaf() ? mergedArea + inheritanceCost
+                : mergedArea - perimeter(child.box) + inheritanceCost;
+        }
+
+        if (cost < childCost[0] && cost < childCost[1]) break;
+        index = childCost[0] < childCost[1] ? children[0] : children[1];
+    }
+
+    int sibling = index;
+    int oldParent = nodes[sibling].parent;
+    int newParent = allocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].box = mergeAABB(leafBox, nodes[sibling].box);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent != nullNode) {
+        if (nodes[oldParent].child1 == sibling) {
+            nodes[oldParent].child1 = newParent;
+        }
+        else {
+            nodes[oldParent].child2 = newParent;
+        }
+    }
+    else {
+        root = newParent;
+    }
+
+    refitUpward(nodes[leaf].parent);
+}
+
+void DynamicAABBTree::removeLeaf(int leaf) {
+    if (leaf == root) {
+        root = nullNode;
+        return;
+    }
+
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+    if (grandParent != nullNode) {
+        if (nodes[grandParent].child1 == parent) {
+            nodes[grandParent].child1 = sibling;
+        }
+        else {
+            nodes[grandParent].child2 = sibling;
+        }
+        nodes[sibling].parent = grandParent;
+        freeNode(parent);
+        refitUpward(grandParent);
+    }
+    else {
+        root = sibling;
+        nodes[sibling].parent = nullNode;
+        freeNode(parent);
+    }
+    nodes[leaf].parent = nullNode;
+}
+
+void DynamicAABBTree::refitUpward(int index) {
+    while (index != nullNode) {
+        index = balance(index);
+
+        Node& node = nodes[index];
+        const Node& child1 = nodes[node.child1];
+        const Node& child2 = nodes[node.child2];
+        node.height = 1 + std::max(child1.height, child2.height);
+        node.box = mergeAABB(child1.box, child2.box);
+
+        index = node.parent;
+    }
+}
+
+int DynamicAABBTree::balance(int iA) {
+    Node& A = nodes[iA];
+    if (A.isLeaf() || A.height < 2) {
+        return iA;
+    }
+
+    int iB = A.child1;
+    int iC = A.child2;
+    Node& B = nodes[iB];
+    Node& C = nodes[iC];
+    int heightDiff = C.height - B.height;
+
+    // C 를 위로 회전
+    if (heightDiff > 1) {
+        int iF = C.child1;
+        int iG = C.child2;
+        Node& F = nodes[iF];
+        Node& G = nodes[iG];
+
+        C.child1 = iA;
+        C.parent = A.parent;
+        A.parent = iC;
+
+        if (C.parent != nullNode) {
+            if (nodes[C.parent].child1 == iA) {
+                nodes[C.parent].child1 = iC;
+            }
+            else {
+                nodes[C.parent].child2 = iC;
+            }
+        }
+        else {
+            root = iC;
+        }
+
+        if (F.height > G.height) {
+            C.child2 = iF;
+            A.child2 = iG;
+            G.parent = iA;
+            A.box = mergeAABB(B.box, G.box);
+            C.box = mergeAABB(A.box, F.box);
+            A.height = 1 + std::max(B.height, G.height);
+            C.height = 1 + std::max(A.height, F.height);
+        }
+        else {
+            C.child2 = iG;
+            A.child2 = iF;
+            F.parent = iA;
+            A.box = mergeAABB(B.box, F.box);
+            C.box = mergeAABB(A.box, G.box);
+            A.height = 1 + std::max(B.height, F.height);
+            C.height = 1 + std::max(A.height, G.height);
+        }
+
+        ++stats.rotations;
+        return iC;
+    }
+
+    // B 를 위로 회전
+    if (heightDiff < -1) {
+        int iD = B.child1;
+        int iE = B.child2;
+        Node& D = nodes[iD];
+        Node& E = nodes[iE];
+
+        B.child1 = iA;
+        B.parent = A.parent;
+        A.parent = iB;
+
+        if (B.parent != nullNode) {
+            if (nodes[B.parent].child1 == iA) {
+                nodes[B.parent].child1 = iB;
+            }
+            else {
+                nodes[B.parent].child2 = iB;
+            }
+        }
+        else {
+            root = iB;
+        }
+
+        if (D.height > E.height) {
+            B.child2 = iD;
+            A.child1 = iE;
+            E.parent = iA;
+            A.box = mergeAABB(C.box, E.box);
+            B.box = mergeAABB(A.box, D.box);
+            A.height = 1 + std::max(C.height, E.height);
+            B.height = 1 + std::max(A.height, D.height);
+        }
+        else {
+            B.child2 = iE;
+            A.child1 = iD;
+            D.parent = iA;
+            A.box = mergeAABB(C.box, D.box);
+            B.box = mergeAABB(A.box, E.box);
+            A.height = 1 + std::max(C.height, D.height);
+            B.height = 1 + std::max(A.height, E.height);
+        }
+
+        ++stats.rotations;
+        return iB;
+    }
+
+    return iA;
+}
+
+void DynamicAABBTree::updatePairs(const std::function<void(int, int)>& callback) {
+    std::vector<std::pair<int, int>> pairs;
+
+    for (int proxy : moveBuffer) {
+        nodes[proxy].moved = false;
+        const AABB& fatBox = nodes[proxy].box;
+        query(fatBox, [&](int other) {
+            if (other != proxy) {
+                pairs.emplace_back(std::min(proxy, other), std::max(proxy, other));
+            }
+            return true;
+        });
+    }
+    moveBuffer.clear();
+
+    // 둘 다 움직인 경우 같은 쌍이 두 번 나오므로 정렬 후 중복 제거
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    for (const auto& pair : pairs) {
+        callback(nodes[pair.first].userData, nodes[pair.second].userData);
+    }
+    stats.pairsReported += static_cast<int>(pairs.size());
+}
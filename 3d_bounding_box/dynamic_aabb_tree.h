@@ -0,0 +1,95 @@
+﻿#pragma once
+
+#include <functional>
+#include <vector>
+#include "geometry.h"
+
+struct DynamicTreeStats {
+    int proxiesMoved = 0;
+    int proxiesReinserted = 0;
+    int rotations = 0;
+    int nodesVisited = 0;
+    int pairsReported = 0;
+};
+
+// instance 단위 broad phase 용 incremental AABB 트리.
+// leaf 는 실제 box 를 fatMargin 만큼 키운 fat box 를 가지며, 물체가 fat box 안에서
+// 움직이는 동안은 트리를 건드리지 않는다. 삽입/삭제 후에는 회전으로 높이를 맞춘다.
+class DynamicAABBTree {
+public:
+    static const int nullNode = -1;
+
+    explicit DynamicAABBTree(float fatMargin = 0.1f);
+
+    int createProxy(const AABB& box, int userData);
+    void destroyProxy(int proxy);
+    bool moveProxy(int proxy, const AABB& box, const glm::vec3& displacement = glm::vec3(0.0f));
+
+    const AABB& getFatAABB(int proxy) const { return nodes[proxy].box; }
+    int getUserData(int proxy) const { return nodes[proxy].userData; }
+    int getHeight() const { return root == nullNode ? 0 : nodes[root].height; }
+
+    // callback(proxy) 가 false 를 반환하면 탐색 중단
+    template <typename Callback>
+    void query(const AABB& box, Callback callback) const;
+
+    // 지난 호출 이후 다시 삽입된 proxy 와 fat box 가 겹치는 쌍을 userData 로 보고한다
+    void updatePairs(const std::function<void(int, int)>& callback);
+
+    const DynamicTreeStats& getStats() const { return stats; }
+    void resetStats() { stats = DynamicTreeStats(); }
+
+private:
+    struct Node {
+        AABB box;
+        int parent = nullNode;
+        int child1 = nullNode;
+        int child2 = nullNode;
+        int height = -1;  // 빈 노드는 -1, leaf 는 0
+        int userData = -1;
+        bool moved = false;
+
+        bool isLeaf() const { return child1 == nullNode; }
+    };
+
+    int allocateNode();
+    void freeNode(int node);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    int balance(int node);
+    void refitUpward(int node);
+    void markMoved(int proxy);
+
+    std::vector<Node> nodes;
+    int root = nullNode;
+    int freeList = nullNode;
+    float fatMargin;
+
+    std::vector<int> moveBuffer;
+    mutable DynamicTreeStats stats;
+};
+
+template <typename Callback>
+void DynamicAABBTree::query(const AABB& box, Callback callback) const {
+    if (root == nullNode) return;
+
+    std::vector<int> stack;
+    stack.reserve(64);
+    stack.push_back(root);
+    while (!stack.empty()) {
+        int index = stack.back();
+        stack.pop_back();
+
+        const Node& node = nodes[index];
+        ++stats.nodesVisited;
+        if (!checkAABBCollision(node.box, box)) continue;
+
+        if (node.isLeaf()) {
+            if (!callback(index)) return;
+        }
+        else {
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
@@ -0,0 +1,80 @@
+﻿#include "geometry.h"
+
+glm::vec3 calculateCenter(const AABB& box) {
+    return (box.min + box.max) * 0.5f;
+}
+
+AABB calculateAABB(const std::vector<Triangle>& triangles) {
+    AABB box;
+    if (triangles.empty()) return box;
+
+    box.min = triangles[0].vertices[0];
+    box.max = triangles[0].vertices[0];
+
+    for (const auto& tri : triangles) {
+        for (int i = 0; i < 3; ++i) {
+            box.min = glm::min(box.min, tri.vertices[i]);
+            box.max = glm::max(box.max, tri.vertices[i]);
+        }
+    }
+    return box;
+}
+
+AABB mergeAABB(const AABB& box1, const AABB& box2) {
+    AABB box;
+    box.min = glm::min(box1.min, box2.min);
+    box.max = glm::max(box1.max, box2.max);
+    return box;
+}
+
+AABB transformAABB(const AABB& box, const glm::mat4& transform) {
+    // Arvo 방식: 축별로 min/max 누적
+    AABB result;
+    result.min = glm::vec3(transform[3]);
+    result.max = glm::vec3(transform[3]);
+
+    for (int col = 0; col < 3; ++col) {
+        for (int row = 0; row < 3; ++row) {
+            float a = transform[col][row] * box.min[col];
+            float b = transform[col][row] * box.max[col];
+            result.min[row] += glm::min(a, b);
+            result.max[row] += glm::max(a, b);
+        }
+    }
+    return result;
+}
+
+bool checkTriangleAABBCollision(const glm::vec3 triangle[3], const AABB& box) {
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 half = (box.max - box.min) * 0.5f;
+    glm::vec3 v[3] = { triangle[0] - center, triangle[1] - center, triangle[2] - center };
+
+    for (int i = 0; i < 3; ++i) {
+        if (glm::min(glm::min(v[0][i], v[1][i]), v[2][i]) > half[i] ||
+            glm::max(glm::max(v[0][i], v[1][i]), v[2][i]) < -half[i]) {
+            return false;
+        }
+    }
+
+    glm::vec3 edges[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+    glm::vec3 normal = glm::cross(edges[0], edges[1]);
+    if (glm::abs(glm::dot(normal, v[0])) > glm::dot(half, glm::abs(normal))) {
+        return false;
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        glm::vec3 unit(0.0f);
+        unit[i] = 1.0f;
+        for (int j = 0; j < 3; ++j) {
+            glm::vec3 axis = glm::cross(unit, edges[j]);
+            float p0 = glm::dot(v[0], axis);
+            float p1 = glm::dot(v[1], axis);
+            float p2 = glm::dot(v[2], axis);
+            float r = glm::dot(half, glm::abs(axis));
+            if (glm::min(glm::min(p0, p1), p2) > r || glm::max(glm::max(p0, p1), p2) < -r) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,28 @@
+﻿#pragma once
+
+#include <vector>
+#include <glm/glm/glm.hpp>
+
+struct Triangle {
+    glm::vec3 normal;
+    glm::vec3 vertices[3];
+};
+
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+glm::vec3 calculateCenter(const AABB& box);
+AABB calculateAABB(const std::vector<Triangle>& triangles);
+AABB mergeAABB(const AABB& box1, const AABB& box2);
+AABB transformAABB(const AABB& box, const glm::mat4& transform);
+
+// 분리 축 정리 (box 축 3개, 삼각형 법선, 모서리 x 축 9개). 경계에 닿기만 해도 겹침으로 본다
+bool checkTriangleAABBCollision(const glm::vec3 triangle[3], const AABB& box);
+
+inline bool checkAABBCollision(const AABB& box1, const AABB& box2) {
+    return (box1.min.x <= box2.max.x && box1.max.x >= box2.min.x) &&
+        (box1.min.y <= box2.max.y && box1.max.y >= box2.min.y) &&
+        (box1.min.z <= box2.max.z && box1.max.z >= box2.min.z);
+}
@@ -0,0 +1,270 @@
+﻿#include "gjk.h"
+
+#include <cfloat>
+#include <cmath>
+
+namespace {
+
+struct SimplexVertex {
+    glm::vec3 a;  // a 의 support 점
+    glm::vec3 b;  // b 의 support 점 (a 좌표계)
+    glm::vec3 w;  // a - b
+    int indexA;
+    int indexB;
+    float weight;
+};
+
+struct Simplex {
+    SimplexVertex v[4];
+    int count = 0;
+
+    glm::vec3 closest() const {
+        glm::vec3 p(0.0f);
+        for (int i = 0; i < count; ++i) p += v[i].w * v[i].weight;
+        return p;
+    }
+};
+
+int support(const IndexedMesh& mesh, const glm::vec3& direction) {
+    int best = 0;
+    float bestDot = -FLT_MAX;
+    for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+        float d = glm::dot(mesh.vertices[i], direction);
+        if (d > bestDot) {
+            bestDot = d;
+            best = static_cast<int>(i);
+        }
+    }
+    return best;
+}
+
+void keep(Simplex& s, int i0) {
+    s.v[0] = s.v[i0];
+    s.v[0].weight = 1.0f;
+    s.count = 1;
+}
+
+void keep(Simplex& s, int i0, int i1, float w0, float w1) {
+    SimplexVertex a = s.v[i0], b = s.v[i1];
+    s.v[0] = a;
+    s.v[1] = b;
+    s.v[0].weight = w0;
+    s.v[1].weight = w1;
+    s.count = 2;
+}
+
+// 원점에 가장 가까운 선분 위의 점
+void solveSegment(Simplex& s, int i0, int i1) {
+    glm::vec3 a = s.v[i0].w, b = s.v[i1].w;
+    glm::vec3 ab = b - a;
+    float denom = glm::dot(ab, ab);
+    float t = denom > 0.0f ? -glm::dot(a, ab) / denom : 0.0f;
+    if (t <= 0.0f) {
+        keep(s, i0);
+    }
+    else if (t >= 1.0f) {
+        keep(s, i1);
+    }
+    else {
+        keep(s, i0, i1, 1.0f - t, t);
+    }
+}
+
+// Ericson, Real-Time Collision Detection 5.1.5 의 영역 판정을 원점에 대해 적용
+void solveTriangle(Simplex& s, int i0, int i1, int i2) {
+    glm::vec3 a = s.v[i0].w, b = s.v[i1].w, c = s.v[i2].w;
+    glm::vec3 ab = b - a, ac = c - a, ap = -a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) { keep(s, i0); return; }
+
+    glm::vec3 bp = -b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) { keep(s, i1); return; }
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        float t = d1 / (d1 - d3);
+        keep(s, i0, i1, 1.0f - t, t);
+        return;
+    }
+
+    glm::vec3 cp = -c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) { keep(s, i2); return; }
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        float t = d2 / (d2 - d6);
+        keep(s, i0, i2, 1.0f - t, t);
+        return;
+    }
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        float t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        keep(s, i1, i2, 1.0f - t, t);
+        return;
+    }
+
+    float denom = 1.0f / (va + vb + vc);
+    SimplexVertex x = s.v[i0], y = s.v[i1], z = s.v[i2];
+    s.v[0] = x;
+    s.v[1] = y;
+    s.v[2] = z;
+    s.v[0].weight = va * denom;
+    s.v[1].weight = vb * denom;
+    s.v[2].weight = vc * denom;
+    s.count = 3;
+}
+
+// 원점이 면 (a, b, c) 의 d 반대쪽에 있는지
+bool outsideFace(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d) {
+    glm::vec3 n = glm::cross(b - a, c - a);
+    float signOrigin = glm::dot(-a, n);
+    float signD = glm::dot(d - a, n);
+    return signOrigin * signD < 0.0f;
+}
+
+// 원점이 사면체 안이면 false (교차)
+bool solveTetrahedron(Simplex& s) {
+    static const int faces[4][4] = { { 0, 1, 2, 3 }, { 0, 2, 3, 1 }, { 0, 3, 1, 2 }, { 1, 3, 2, 0 } };
+
+    // 부피가 거의 0 이면 안팎을 가릴 수 없으므로 네 면을 모두 본다
+    glm::vec3 e1 = s.v[1].w - s.v[0].w, e2 = s.v[2].w - s.v[0].w, e3 = s.v[3].w - s.v[0].w;
+    float volume = std::abs(glm::dot(e1, glm::cross(e2, e3)));
+    float scale = glm::length(e1) * glm::length(e2) * glm::length(e3);
+    bool degenerate = volume <= FLT_EPSILON * scale;
+
+    Simplex best;
+    float bestDistance = FLT_MAX;
+    bool outside = false;
+    for (const auto& face : faces) {
+        if (!degenerate && !outsideFace(s.v[face[0]].w, s.v[face[1]].w, s.v[face[2]].w, s.v[face[3]].w)) continue;
+        outside = true;
+
+        Simplex candidate = s;
+        solveTriangle(candidate, face[0], face[1], face[2]);
+        glm::vec3 p = candidate.closest();
+        float distance = glm::dot(p, p);
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = candidate;
+        }
+    }
+
+    if (!outside) {
+        return false;
+    }
+    s = best;
+    return true;
+}
+
+SimplexVertex makeVertex(const IndexedMesh& a, const IndexedMesh& b, const glm::mat4& bToA, int indexA, int indexB) {
+    SimplexVertex v;
+    v.indexA = indexA;
+    v.indexB = indexB;
+    v.a = a.vertices[indexA];
+    v.b = glm::vec3(bToA * glm::vec4(b.vertices[indexB], 1.0f));
+    v.w = v.a - v.b;
+    v.weight = 1.0f;
+    return v;
+}
+
+GjkResult solve(const IndexedMesh& a, const IndexedMesh& b, const glm::mat4& bToA, GjkCache* cache, bool stopOnSeparation) {
+    GjkResult result;
+    if (a.vertices.empty() || b.vertices.empty()) {
+        result.distance = FLT_MAX;
+        return result;
+    }
+
+    Simplex simplex;
+    if (cache && cache->count > 0) {
+        for (int i = 0; i < cache->count; ++i) {
+            simplex.v[i] = makeVertex(a, b, bToA, cache->indexA[i], cache->indexB[i]);
+        }
+        simplex.count = cache->count;
+        for (int i = 0; i < simplex.count; ++i) simplex.v[i].weight = 1.0f / simplex.count;
+    }
+    else {
+        simplex.v[0] = makeVertex(a, b, bToA, 0, 0);
+        simplex.count = 1;
+    }
+
+    glm::mat3 aToBRotation = glm::transpose(glm::mat3(bToA));
+    const int maxIterations = 64;
+    bool intersecting = false;
+    float lastDistanceSq = FLT_MAX;
+
+    for (int iteration = 0; iteration < maxIterations; ++iteration) {
+        result.iterations = iteration + 1;
+
+        switch (simplex.count) {
+        case 2: solveSegment(simplex, 0, 1); break;
+        case 3: solveTriangle(simplex, 0, 1, 2); break;
+        case 4: intersecting = !solveTetrahedron(simplex); break;
+        default: break;
+        }
+        if (intersecting) break;
+
+        glm::vec3 v = simplex.closest();
+        float vv = glm::dot(v, v);
+        if (vv < 1e-12f) {
+            intersecting = true;
+            break;
+        }
+        // 평행한 면끼리 만나 사면체가 납작해지면 더 가까워지지 않는다
+        if (vv >= lastDistanceSq) {
+            break;
+        }
+        lastDistanceSq = vv;
+
+        // 원점 쪽 방향으로 a - b 의 support 점
+        glm::vec3 direction = -v;
+        int indexA = support(a, direction);
+        int indexB = support(b, aToBRotation * v);
+        SimplexVertex w = makeVertex(a, b, bToA, indexA, indexB);
+
+        if (stopOnSeparation && glm::dot(w.w, direction) < 0.0f) {
+            break;
+        }
+
+        // 새 점이 이미 simplex 에 있거나 더 가까워지지 않으면 수렴
+        bool duplicate = false;
+        for (int i = 0; i < simplex.count; ++i) {
+            duplicate |= simplex.v[i].indexA == indexA && simplex.v[i].indexB == indexB;
+        }
+        if (duplicate || vv - glm::dot(v, w.w) <= 1e-5f * vv) {
+            break;
+        }
+
+        simplex.v[simplex.count++] = w;
+    }
+
+    result.intersecting = intersecting;
+    if (!intersecting) {
+        for (int i = 0; i < simplex.count; ++i) {
+            result.pointA += simplex.v[i].a * simplex.v[i].weight;
+            result.pointB += simplex.v[i].b * simplex.v[i].weight;
+        }
+        result.distance = glm::length(result.pointA - result.pointB);
+    }
+
+    if (cache) {
+        cache->count = simplex.count;
+        for (int i = 0; i < simplex.count; ++i) {
+            cache->indexA[i] = simplex.v[i].indexA;
+            cache->indexB[i] = simplex.v[i].indexB;
+        }
+    }
+    return result;
+}
+
+}
+
+GjkResult gjkDistance(const IndexedMesh& a, const IndexedMesh& b, const glm::mat4& bToA, GjkCache* cache) {
+    return solve(a, b, bToA, cache, false);
+}
+
+bool gjkIntersect(const IndexedMesh& a, const IndexedMesh& b, const glm::mat4& bToA, GjkCache* cache) {
+    return solve(a, b, bToA, cache, true).intersecting;
+}
@@ -0,0 +1,28 @@
+﻿#pragma once
+
+#include <glm/glm/glm.hpp>
+#include "mesh.h"
+
+// 이전 호출에서 끝난 simplex 의 꼭짓점 번호. 같은 쌍을 다음 프레임에 다시 검사할 때
+// 여기서 시작하면 자세가 조금 바뀐 경우 대개 한두 번 반복으로 끝난다
+struct GjkCache {
+    int count = 0;
+    int indexA[4];
+    int indexB[4];
+};
+
+// pointA, pointB 는 a 좌표계에서 가장 가까운 두 점 (겹치면 의미 없음)
+struct GjkResult {
+    bool intersecting = false;
+    float distance = 0.0f;
+    glm::vec3 pointA = glm::vec3(0.0f);
+    glm::vec3 pointB = glm::vec3(0.0f);
+    int iterations = 0;
+};
+
+// a, b 의 꼭짓점으로 만든 볼록 껍질 사이의 거리. b 는 bToA 로 a 좌표계로 옮긴다.
+// 보통 computeConvexHull 결과를 넘기며, 꼭짓점 전체를 넘겨도 결과는 같다
+GjkResult gjkDistance(const IndexedMesh& a, const IndexedMesh& b, const glm::mat4& bToA, GjkCache* cache = nullptr);
+
+// 분리 축을 찾는 즉시 끝나는 교차 검사
+bool gjkIntersect(const IndexedMesh& a, const IndexedMesh& b, const glm::mat4& bToA, GjkCache* cache = nullptr);
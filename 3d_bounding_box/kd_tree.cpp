@@ -0,0 +1,301 @@
+﻿#include "kd_tree.h"
+
+#include <algorithm>
+#include <cmath>
+#include "parallel.h"
+
+struct KdTree::Edge {
+    float t;
+    int triangle;
+    bool start;
+
+    // 같은 위치에서는 시작을 먼저 둔다 (그 평면에 놓인 삼각형이 양쪽에 세어진다)
+    bool operator<(const Edge& other) const {
+        if (t != other.t) return t < other.t;
+        return start && !other.start;
+    }
+};
+
+namespace {
+
+const int leafAxis = 3;
+// 광선 검사 stack 크기. 깊이가 이보다 깊어지지 않게 maxDepth 를 제한한다
+const int maxStackDepth = 64;
+
+float surfaceArea(const AABB& box) {
+    glm::vec3 size = box.max - box.min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+bool insideAABB(const AABB& inner, const AABB& outer) {
+    return glm::all(glm::greaterThanEqual(inner.min, outer.min)) && glm::all(glm::lessThanEqual(inner.max, outer.max));
+}
+
+// 삼각형을 box 의 6 평면으로 잘라 (Sutherland-Hodgman) 남은 다각형의 box. 남는 것이 없으면 false
+bool clipTriangle(const Triangle& triangle, const AABB& box, AABB& clipped) {
+    glm::vec3 polygon[9], next[9];
+    int count = 3;
+    for (int i = 0; i < 3; ++i) polygon[i] = triangle.vertices[i];
+
+    for (int plane = 0; plane < 6 && count > 0; ++plane) {
+        int axis = plane >> 1;
+        bool upper = (plane & 1) != 0;
+        float bound = upper ? box.max[axis] : box.min[axis];
+        int nextCount = 0;
+        for (int i = 0; i < count; ++i) {
+            const glm::vec3& a = polygon[i];
+            const glm::vec3& b = polygon[(i + 1) % count];
+            float da = upper ? bound - a[axis] : a[axis] - bound;
+            float db = upper ? bound - b[axis] : b[axis] - bound;
+            if (da >= 0.0f) next[nextCount++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f)) {
+                glm::vec3 p = a + (b - a) * (da / (da - db));
+                p[axis] = bound;
+                next[nextCount++] = p;
+            }
+        }
+        count = nextCount;
+        std::copy(next, next + count, polygon);
+    }
+    if (count == 0) return false;
+
+    clipped.min = clipped.max = polygon[0];
+    for (int i = 1; i < count; ++i) {
+        clipped.min = glm::min(clipped.min, polygon[i]);
+        clipped.max = glm::max(clipped.max, polygon[i]);
+    }
+    clipped.min = glm::max(clipped.min, box.min);
+    clipped.max = glm::min(clipped.max, box.max);
+    return true;
+}
+
+AABB triangleBounds(const Triangle& triangle) {
+    AABB box;
+    box.min = glm::min(glm::min(triangle.vertices[0], triangle.vertices[1]), triangle.vertices[2]);
+    box.max = glm::max(glm::max(triangle.vertices[0], triangle.vertices[1]), triangle.vertices[2]);
+    return box;
+}
+
+}
+
+void KdTree::build(const std::vector<Triangle>& input, const KdTreeParams& buildParams) {
+    nodes.clear();
+    leafTriangles.clear();
+    triangles = input;
+    params = buildParams;
+    depth = 0;
+    if (triangles.empty()) return;
+
+    bounds = calculateAABB(triangles);
+    maxDepth = params.maxDepth > 0 ? params.maxDepth
+        : static_cast<int>(std::lround(8.0 + 1.3 * std::log2(static_cast<double>(triangles.size()))));
+    maxDepth = std::min(maxDepth, maxStackDepth);
+
+    std::vector<int> indices(triangles.size());
+    for (size_t i = 0; i < indices.size(); ++i) {
+        indices[i] = static_cast<int>(i);
+    }
+    std::vector<Edge> edges;
+    buildNode(bounds, indices, 0, 0, edges);
+}
+
+void KdTree::makeLeaf(const std::vector<int>& indices) {
+    Node node;
+    node.flags = (static_cast<uint32_t>(indices.size()) << 2) | leafAxis;
+    node.first = static_cast<uint32_t>(leafTriangles.size());
+    leafTriangles.insert(leafTriangles.end(), indices.begin(), indices.end());
+    nodes.push_back(node);
+}
+
+void KdTree::buildNode(const AABB& box, std::vector<int>& indices, int level, int badRefines, std::vector<Edge>& edges) {
+    depth = std::max(depth, level);
+    size_t count = indices.size();
+    if (count <= params.leafSize || level >= maxDepth) {
+        makeLeaf(indices);
+        return;
+    }
+
+    // 노드 box 로 자른 삼각형 box. box 에 닿지 않는 삼각형은 여기서 빠진다
+    std::vector<AABB> clipped(count);
+    size_t kept = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const Triangle& triangle = triangles[indices[i]];
+        AABB triangleBox = triangleBounds(triangle);
+        if (insideAABB(triangleBox, box)) {
+            clipped[kept] = triangleBox;
+        }
+        else if (!clipTriangle(triangle, box, clipped[kept])) {
+            continue;
+        }
+        indices[kept++] = indices[i];
+    }
+    indices.resize(kept);
+    clipped.resize(kept);
+    count = kept;
+    if (count <= params.leafSize) {
+        makeLeaf(indices);
+        return;
+    }
+
+    float area = surfaceArea(box);
+    float invArea = area > 0.0f ? 1.0f / area : 0.0f;
+    float leafCost = params.intersectionCost * static_cast<float>(count);
+    float bestCost = INFINITY;
+    int bestAxis = -1;
+    float bestSplit = 0.0f;
+    glm::vec3 size = box.max - box.min;
+
+    for (int axis = 0; axis < 3; ++axis) {
+        edges.clear();
+        for (size_t i = 0; i < count; ++i) {
+            edges.push_back({ clipped[i].min[axis], static_cast<int>(i), true });
+            edges.push_back({ clipped[i].max[axis], static_cast<int>(i), false });
+        }
+        std::sort(edges.begin(), edges.end());
+
+        int other1 = (axis + 1) % 3;
+        int other2 = (axis + 2) % 3;
+        size_t below = 0;
+        size_t above = count;
+        for (size_t e = 0; e < edges.size(); ++e) {
+            if (!edges[e].start) --above;
+
+            float t = edges[e].t;
+            if (t > box.min[axis] && t < box.max[axis]) {
+                float belowArea = 2.0f * (size[other1] * size[other2] + (t - box.min[axis]) * (size[other1] + size[other2]));
+                float aboveArea = 2.0f * (size[other1] * size[other2] + (box.max[axis] - t) * (size[other1] + size[other2]));
+                float bonus = (below == 0 || above == 0) ? params.emptyBonus : 0.0f;
+                float cost = params.traversalCost + params.intersectionCost * (1.0f - bonus) *
+                    (belowArea * invArea * static_cast<float>(below) + aboveArea * invArea * static_cast<float>(above));
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = t;
+                }
+            }
+
+            if (edges[e].start) ++below;
+        }
+    }
+
+    // 나누는 편이 비싸도 몇 번은 더 나눠 본다 (더 아래에서 좋은 분할이 나올 수 있다)
+    if (bestCost > leafCost) ++badRefines;
+    if (bestAxis < 0 || (bestCost > 4.0f * leafCost && count < 16) || badRefines >= 3) {
+        makeLeaf(indices);
+        return;
+    }
+
+    // 분할 평면에 놓인 삼각형은 아래쪽에만 둔다
+    std::vector<int> belowIndices, aboveIndices;
+    for (size_t i = 0; i < count; ++i) {
+        const AABB& c = clipped[i];
+        bool planar = c.min[bestAxis] == bestSplit && c.max[bestAxis] == bestSplit;
+        if (c.min[bestAxis] < bestSplit || planar) belowIndices.push_back(indices[i]);
+        if (c.max[bestAxis] > bestSplit) aboveIndices.push_back(indices[i]);
+    }
+    std::vector<int>().swap(indices);
+    std::vector<AABB>().swap(clipped);
+
+    AABB belowBox = box;
+    AABB aboveBox = box;
+    belowBox.max[bestAxis] = bestSplit;
+    aboveBox.min[bestAxis] = bestSplit;
+
+    size_t index = nodes.size();
+    Node node;
+    node.flags = static_cast<uint32_t>(bestAxis);
+    node.split = bestSplit;
+    nodes.push_back(node);
+
+    buildNode(belowBox, belowIndices, level + 1, badRefines, edges);
+    nodes[index].flags |= static_cast<uint32_t>(nodes.size()) << 2;
+    buildNode(aboveBox, aboveIndices, level + 1, badRefines, edges);
+}
+
+RayHit KdTree::raycast(const glm::vec3& origin, const glm::vec3& direction, float tMax) const {
+    RayHit hit;
+    hit.distance = tMax;
+    if (nodes.empty()) return hit;
+
+    glm::vec3 invDirection = 1.0f / direction;
+    float tMin;
+    if (!intersectRayAABB(origin, invDirection, bounds, tMax, tMin)) return hit;
+
+    // bounds 의 출구 t (intersectRayAABB 는 진입 t 만 주므로 따로 구한다)
+    float tExit = tMax;
+    for (int axis = 0; axis < 3; ++axis) {
+        float t1 = (bounds.min[axis] - origin[axis]) * invDirection[axis];
+        float t2 = (bounds.max[axis] - origin[axis]) * invDirection[axis];
+        tExit = std::min(tExit, std::max(t1, t2));
+    }
+
+    struct StackEntry {
+        uint32_t node;
+        float tMin, tMax;
+    };
+    StackEntry stack[maxStackDepth];
+    int stackSize = 0;
+
+    uint32_t current = 0;
+    float tNear = tMin;
+    float tFar = tExit;
+    for (;;) {
+        if (hit.distance < tNear) break;
+
+        const Node& node = nodes[current];
+        if (!node.isLeaf()) {
+            int axis = node.axis();
+            float tPlane = (node.split - origin[axis]) * invDirection[axis];
+            bool belowFirst = origin[axis] < node.split || (origin[axis] == node.split && direction[axis] <= 0.0f);
+            uint32_t first = belowFirst ? current + 1 : node.payload();
+            uint32_t second = belowFirst ? node.payload() : current + 1;
+
+            // 평면을 구간 밖에서 지나거나 평행하면 (tPlane 이 NaN 이어도) 가까운 쪽만 본다
+            if (!(tPlane <= tFar) || tPlane <= 0.0f) {
+                current = first;
+            }
+            else if (tPlane < tNear) {
+                current = second;
+            }
+            else {
+                stack[stackSize++] = { second, tPlane, tFar };
+                current = first;
+                tFar = tPlane;
+            }
+            continue;
+        }
+
+        for (uint32_t i = 0; i < node.payload(); ++i) {
+            int id = leafTriangles[node.first + i];
+            float t;
+            glm::vec2 barycentric;
+            if (intersectRayTriangle(origin, direction, triangles[id].vertices, t, barycentric) &&
+                t >= 0.0f && t <= hit.distance) {
+                hit.triangle = id;
+                hit.distance = t;
+                hit.barycentric = barycentric;
+            }
+        }
+
+        // 이 leaf 구간 안에서 맞았으면 뒤쪽 노드에는 더 가까운 교차가 없다
+        if (hit.hit() && hit.distance <= tFar) break;
+        if (stackSize == 0) break;
+        const StackEntry& entry = stack[--stackSize];
+        current = entry.node;
+        tNear = entry.tMin;
+        tFar = entry.tMax;
+    }
+    return hit;
+}
+
+void KdTree::raycastBatch(const Ray* rays, size_t count, RayHit* hits) const {
+    parallelFor(count, 256, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; ++i) {
+            hits[i] = raycast(rays[i].origin, rays[i].direction, rays[i].tMax);
+        }
+    });
+}
+
+size_t KdTree::getMemoryUsage() const {
+    return nodes.capacity() * sizeof(Node) + leafTriangles.capacity() * sizeof(int) + triangles.capacity() * sizeof(Triangle);
+}
@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm/glm.hpp>
+#include "geometry.h"
+#include "raycast.h"
+
+struct KdTreeParams {
+    float traversalCost = 1.0f;
+    float intersectionCost = 1.5f;
+    float emptyBonus = 0.2f;  // 한쪽이 비는 분할의 비용을 이 비율만큼 깎는다
+    size_t leafSize = 2;
+    int maxDepth = 0;          // 0 이면 8 + 1.3 log2(n)
+};
+
+// 움직이지 않는 mesh 의 광선 검사용 SAH kd-tree. 노드마다 삼각형을 노드 box 로 잘라낸 다각형의 box 로
+// 분할 후보와 좌우를 정하므로 (split clipping), box 만 걸치고 실제로는 지나가지 않는 삼각형은 자식에 넣지 않는다.
+// 노드는 8 byte 이고 왼쪽 자식은 바로 다음 노드, 오른쪽 자식만 번호를 가진다
+class KdTree {
+public:
+    void build(const std::vector<Triangle>& triangles, const KdTreeParams& params = KdTreeParams());
+
+    // RayHit::triangle 은 build 에 넘긴 삼각형 번호
+    RayHit raycast(const glm::vec3& origin, const glm::vec3& direction, float tMax) const;
+    void raycastBatch(const Ray* rays, size_t count, RayHit* hits) const;
+
+    const AABB& getBounds() const { return bounds; }
+    size_t getNodeCount() const { return nodes.size(); }
+    size_t getLeafReferenceCount() const { return leafTriangles.size(); }
+    int getDepth() const { return depth; }
+    size_t getMemoryUsage() const;
+
+private:
+    struct Node {
+        uint32_t flags;  // 아래 2 bit 가 분할 축, 3 이면 leaf. 위 30 bit 는 오른쪽 자식 번호 또는 leaf 삼각형 수
+        union {
+            float split;
+            uint32_t first;  // leaf 의 leafTriangles 시작 위치
+        };
+
+        bool isLeaf() const { return (flags & 3) == 3; }
+        int axis() const { return flags & 3; }
+        uint32_t payload() const { return flags >> 2; }
+    };
+
+    struct Edge;
+
+    void buildNode(const AABB& box, std::vector<int>& indices, int level, int badRefines, std::vector<Edge>& edges);
+    void makeLeaf(const std::vector<int>& indices);
+
+    std::vector<Node> nodes;
+    std::vector<int> leafTriangles;
+    std::vector<Triangle> triangles;
+    AABB bounds;
+    KdTreeParams params;
+    int maxDepth = 0;
+    int depth = 0;
+};
@@ -0,0 +1,340 @@
+﻿#include "loose_octree.h"
+
+#include <algorithm>
+#include <cmath>
+#include "collision.h"
+
+namespace {
+
+AABB triangleBounds(const glm::vec3* v) {
+    AABB box;
+    box.min = glm::min(glm::min(v[0], v[1]), v[2]);
+    box.max = glm::max(glm::max(v[0], v[1]), v[2]);
+    return box;
+}
+
+bool isFinite(const AABB& box) {
+    for (int axis = 0; axis < 3; ++axis) {
+        if (!std::isfinite(box.min[axis]) || !std::isfinite(box.max[axis])) return false;
+    }
+    return true;
+}
+
+float boxVolume(const AABB& box) {
+    glm::vec3 size = box.max - box.min;
+    return size.x * size.y * size.z;
+}
+
+}
+
+LooseOctree::LooseOctree(float loose, int levels) {
+    setParams(loose, levels);
+}
+
+uint64_t LooseOctree::packCoord(const glm::ivec3& coord) {
+    return static_cast<uint64_t>(coord.x) | (static_cast<uint64_t>(coord.y) << 21) | (static_cast<uint64_t>(coord.z) << 42);
+}
+
+void LooseOctree::setParams(float loose, int levels) {
+    looseness = std::max(loose, 1.01f);
+    maxLevel = std::min(std::max(levels, 0), 20);
+}
+
+void LooseOctree::clear() {
+    root = -1;
+    nodes.clear();
+    freeNodes.clear();
+    cells.clear();
+    triangles.clear();
+    triangleNodes.clear();
+    freeIds.clear();
+}
+
+void LooseOctree::build(const std::vector<Triangle>& input, float loose, int levels) {
+    clear();
+    setParams(loose, levels);
+
+    // cell 이 정육면체가 되도록 가장 긴 축에 맞춘다
+    AABB bounds = calculateAABB(input);
+    glm::vec3 center = calculateCenter(bounds);
+    glm::vec3 size = bounds.max - bounds.min;
+    float half = std::max(std::max(size.x, size.y), size.z) * 0.5f;
+    if (!(half > 0.0f)) half = 1.0f;
+    cube.min = center - glm::vec3(half);
+    cube.max = center + glm::vec3(half);
+
+    triangles = input;
+    triangleNodes.assign(input.size(), 0);
+    placeAll();
+}
+
+void LooseOctree::placeAll() {
+    nodes.clear();
+    freeNodes.clear();
+    cells.assign(maxLevel + 1, std::unordered_map<uint64_t, int>());
+    root = findOrCreate(0, glm::ivec3(0));
+
+    // 지운 번호 (triangleNodes 가 -1) 는 건너뛴다
+    for (size_t i = 0; i < triangles.size(); ++i) {
+        if (triangleNodes[i] < 0) continue;
+        int level;
+        glm::ivec3 coord;
+        place(triangles[i], level, coord);
+        int node = findOrCreate(level, coord);
+        nodes[node].triangles.push_back(static_cast<int>(i));
+        triangleNodes[i] = node;
+    }
+
+    // 부모가 자식보다 먼저 만들어지므로 뒤에서부터 bounds 를 채운다
+    for (size_t n = nodes.size(); n-- > 0;) {
+        updateBounds(static_cast<int>(n));
+    }
+}
+
+bool LooseOctree::fitsCube(const AABB& box) const {
+    glm::vec3 center = calculateCenter(box);
+    glm::vec3 size = box.max - box.min;
+    float extent = std::max(std::max(size.x, size.y), size.z);
+    return glm::all(glm::greaterThanEqual(center, cube.min)) && glm::all(glm::lessThanEqual(center, cube.max)) &&
+        extent <= (looseness - 1.0f) * (cube.max.x - cube.min.x);
+}
+
+void LooseOctree::grow(const AABB& box) {
+    // 축마다 box 중심 쪽으로 cube 를 한 변만큼 늘린다
+    glm::vec3 center = calculateCenter(box);
+    while (!fitsCube(box)) {
+        float size = cube.max.x - cube.min.x;
+        glm::vec3 cubeCenter = calculateCenter(cube);
+        for (int axis = 0; axis < 3; ++axis) {
+            if (center[axis] < cubeCenter[axis]) cube.min[axis] -= size;
+            else cube.max[axis] += size;
+        }
+    }
+    placeAll();
+}
+
+void LooseOctree::place(const Triangle& triangle, int& level, glm::ivec3& coord) const {
+    AABB box = triangleBounds(triangle.vertices);
+    glm::vec3 size = box.max - box.min;
+    float extent = std::max(std::max(size.x, size.y), size.z);
+    float rootSize = cube.max.x - cube.min.x;
+
+    // cell 크기 s 인 level 의 loose box 는 중심이 cell 안에 있는 크기 (looseness - 1) * s 까지의 box 를 담는다
+    level = maxLevel;
+    if (extent > 0.0f) {
+        float fit = std::floor(std::log2((looseness - 1.0f) * rootSize / extent));
+        level = static_cast<int>(std::min(std::max(fit, 0.0f), static_cast<float>(maxLevel)));
+    }
+
+    int resolution = 1 << level;
+    glm::vec3 cellCoord = (calculateCenter(box) - cube.min) / (rootSize / static_cast<float>(resolution));
+    coord = glm::clamp(glm::ivec3(glm::floor(cellCoord)), glm::ivec3(0), glm::ivec3(resolution - 1));
+}
+
+int LooseOctree::findOrCreate(int level, const glm::ivec3& coord) {
+    auto found = cells[level].find(packCoord(coord));
+    if (found != cells[level].end()) return found->second;
+
+    int parent = level > 0 ? findOrCreate(level - 1, coord >> 1) : -1;
+
+    int index;
+    if (!freeNodes.empty()) {
+        index = freeNodes.back();
+        freeNodes.pop_back();
+    }
+    else {
+        index = static_cast<int>(nodes.size());
+        nodes.emplace_back();
+    }
+
+    Node& node = nodes[index];
+    node.triangles.clear();
+    std::fill(node.children, node.children + 8, -1);
+    node.parent = parent;
+    node.level = level;
+    node.coord = coord;
+    node.count = 0;
+    cells[level][packCoord(coord)] = index;
+    if (parent >= 0) {
+        int child = (coord.x & 1) | ((coord.y & 1) << 1) | ((coord.z & 1) << 2);
+        nodes[parent].children[child] = index;
+    }
+    return index;
+}
+
+void LooseOctree::updateBounds(int index) {
+    Node& node = nodes[index];
+    node.count = node.triangles.size();
+    for (size_t i = 0; i < node.triangles.size(); ++i) {
+        AABB box = triangleBounds(triangles[node.triangles[i]].vertices);
+        node.ownBounds = i == 0 ? box : mergeAABB(node.ownBounds, box);
+    }
+    if (!node.triangles.empty()) node.bounds = node.ownBounds;
+
+    for (int i = 0; i < 8; ++i) {
+        if (node.children[i] < 0) continue;
+        const Node& child = nodes[node.children[i]];
+        if (child.count == 0) continue;
+        node.bounds = node.count == 0 ? child.bounds : mergeAABB(node.bounds, child.bounds);
+        node.count += child.count;
+    }
+}
+
+int LooseOctree::insert(const Triangle& triangle) {
+    // 좌표가 유한하지 않으면 cube 를 키워도 들어가지 않는다
+    AABB box = triangleBounds(triangle.vertices);
+    if (!isFinite(box)) return -1;
+    if (root < 0) {
+        build(std::vector<Triangle>(1, triangle), looseness, maxLevel);
+        return 0;
+    }
+    if (!fitsCube(box)) grow(box);
+
+    int id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+        triangles[id] = triangle;
+    }
+    else {
+        id = static_cast<int>(triangles.size());
+        triangles.push_back(triangle);
+        triangleNodes.push_back(-1);
+    }
+
+    int level;
+    glm::ivec3 coord;
+    place(triangle, level, coord);
+    addToNode(findOrCreate(level, coord), id);
+    return id;
+}
+
+void LooseOctree::addToNode(int index, int id) {
+    triangleNodes[id] = index;
+    Node& node = nodes[index];
+    AABB box = triangleBounds(triangles[id].vertices);
+    node.ownBounds = node.triangles.empty() ? box : mergeAABB(node.ownBounds, box);
+    node.triangles.push_back(id);
+
+    for (int n = index; n >= 0; n = nodes[n].parent) {
+        Node& ancestor = nodes[n];
+        ancestor.bounds = ancestor.count == 0 ? box : mergeAABB(ancestor.bounds, box);
+        ++ancestor.count;
+    }
+}
+
+void LooseOctree::remove(int id) {
+    if (id < 0 || id >= static_cast<int>(triangleNodes.size()) || triangleNodes[id] < 0) return;
+
+    int index = triangleNodes[id];
+    std::vector<int>& own = nodes[index].triangles;
+    own.erase(std::find(own.begin(), own.end(), id));
+    triangleNodes[id] = -1;
+    freeIds.push_back(id);
+
+    // 비게 된 노드는 부모에서 떼어 내고 (root 는 남긴다), 나머지 조상은 bounds 를 다시 구한다
+    for (int n = index; n >= 0;) {
+        updateBounds(n);
+        Node& node = nodes[n];
+        int parent = node.parent;
+        if (node.count == 0 && parent >= 0) {
+            // 빈 자식은 먼저 떼어 냈으므로 자식이 남아 있지 않다
+            int child = (node.coord.x & 1) | ((node.coord.y & 1) << 1) | ((node.coord.z & 1) << 2);
+            nodes[parent].children[child] = -1;
+            cells[node.level].erase(packCoord(node.coord));
+            freeNodes.push_back(n);
+        }
+        n = parent;
+    }
+}
+
+size_t LooseOctree::getMemoryUsage() const {
+    size_t bytes = nodes.capacity() * sizeof(Node) + freeNodes.capacity() * sizeof(int) +
+        triangles.capacity() * sizeof(Triangle) + (triangleNodes.capacity() + freeIds.capacity()) * sizeof(int);
+    for (const auto& node : nodes) {
+        bytes += node.triangles.capacity() * sizeof(int);
+    }
+    for (const auto& level : cells) {
+        // 해시 노드 하나에 key, value, next 포인터, bucket 포인터 하나
+        bytes += level.size() * (sizeof(std::pair<const uint64_t, int>) + 2 * sizeof(void*));
+    }
+    return bytes;
+}
+
+bool collideLooseOctrees(const LooseOctree& a, const LooseOctree& b, const glm::mat4& bToA,
+    std::vector<std::pair<int, int>>* pairs) {
+    if (pairs) pairs->clear();
+    if (a.getTriangleCount() == 0 || b.getTriangleCount() == 0) return false;
+
+    // own 이면 노드 자기 삼각형만, 아니면 subtree 전체
+    struct Entry {
+        int a, b;
+        bool ownA, ownB;
+    };
+
+    const std::vector<LooseOctree::Node>& nodesA = a.getNodes();
+    const std::vector<LooseOctree::Node>& nodesB = b.getNodes();
+
+    // b 삼각형은 처음 쓸 때 한 번만 옮긴다
+    thread_local std::vector<Entry> stack;
+    thread_local std::vector<glm::vec3> transformedB;
+    thread_local std::vector<uint32_t> transformedStamp;
+    thread_local uint32_t stamp = 0;
+    if (transformedStamp.size() < b.getTriangleCapacity()) {
+        transformedStamp.assign(b.getTriangleCapacity(), 0);
+        transformedB.resize(b.getTriangleCapacity() * 3);
+        stamp = 0;
+    }
+    if (++stamp == 0) {
+        std::fill(transformedStamp.begin(), transformedStamp.end(), 0);
+        stamp = 1;
+    }
+
+    bool found = false;
+    stack.clear();
+    stack.push_back({ a.getRoot(), b.getRoot(), false, false });
+    while (!stack.empty()) {
+        Entry entry = stack.back();
+        stack.pop_back();
+        const LooseOctree::Node& nodeA = nodesA[entry.a];
+        const LooseOctree::Node& nodeB = nodesB[entry.b];
+        const AABB& boxA = entry.ownA ? nodeA.ownBounds : nodeA.bounds;
+        if (!checkAABBCollision(boxA, transformAABB(entry.ownB ? nodeB.ownBounds : nodeB.bounds, bToA))) continue;
+
+        if (entry.ownA && entry.ownB) {
+            for (int idA : nodeA.triangles) {
+                const glm::vec3* triA = a.getTriangle(idA).vertices;
+                AABB triBoxA = triangleBounds(triA);
+                for (int idB : nodeB.triangles) {
+                    glm::vec3* triB = &transformedB[idB * 3];
+                    if (transformedStamp[idB] != stamp) {
+                        for (int k = 0; k < 3; ++k) {
+                            triB[k] = glm::vec3(bToA * glm::vec4(b.getTriangle(idB).vertices[k], 1.0f));
+                        }
+                        transformedStamp[idB] = stamp;
+                    }
+                    if (!checkAABBCollision(triBoxA, triangleBounds(triB)) || !checkTriangleCollision(triA, triB)) continue;
+
+                    if (!pairs) return true;
+                    pairs->push_back(std::make_pair(idA, idB));
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // subtree 쪽을 자기 삼각형과 자식 subtree 들로 나눈다. 둘 다 subtree 이면 큰 쪽을 나눈다
+        bool splitA = !entry.ownA && (entry.ownB || boxVolume(nodeA.bounds) >= boxVolume(nodeB.bounds));
+        const LooseOctree::Node& node = splitA ? nodeA : nodeB;
+        const std::vector<LooseOctree::Node>& nodes = splitA ? nodesA : nodesB;
+        if (!node.triangles.empty()) {
+            stack.push_back(splitA ? Entry{ entry.a, entry.b, true, entry.ownB } : Entry{ entry.a, entry.b, entry.ownA, true });
+        }
+        for (int i = 0; i < 8; ++i) {
+            int child = node.children[i];
+            if (child < 0 || nodes[child].count == 0) continue;
+            stack.push_back(splitA ? Entry{ child, entry.b, false, entry.ownB } : Entry{ entry.a, child, entry.ownA, false });
+        }
+    }
+    return found;
+}
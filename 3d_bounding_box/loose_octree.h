@@ -0,0 +1,74 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <glm/glm/glm.hpp>
+#include "geometry.h"
+
+// 각 삼각형을 cell 하나에만 두는 loose octree. level L 의 cell 을 looseness 배로 키운 box 에 들어가는
+// 가장 깊은 level 을 삼각형 크기로 고르고, 그 level 에서 box 중심이 있는 cell 에 둔다.
+// buildOctree 처럼 여러 cell 에 복사하지 않으므로 메모리가 삼각형 수에 비례하고, 내부 노드에도 삼각형이 있다.
+// cell 은 level 마다 좌표 해시로 찾으므로 삽입은 깊이만큼 내려가지 않는다 (없는 조상 노드만 만든다)
+class LooseOctree {
+public:
+    struct Node {
+        AABB bounds;     // subtree 의 모든 삼각형을 감싸는 box
+        AABB ownBounds;  // 이 cell 에 둔 삼각형만 감싸는 box
+        std::vector<int> triangles;
+        int children[8];
+        int parent;
+        int level;
+        glm::ivec3 coord;
+        size_t count;    // subtree 의 삼각형 수
+    };
+
+    // looseness 는 1 보다 커야 한다 (2 이면 cell 크기까지의 삼각형이 그 level 에 들어간다).
+    // 생성자의 값은 build 없이 insert 로 채우는 tree 에 쓰인다
+    explicit LooseOctree(float looseness = 2.0f, int maxLevel = 5);
+
+    void build(const std::vector<Triangle>& triangles, float looseness = 2.0f, int maxLevel = 5);
+    // 반환값은 삼각형 번호. 삼각형이 root cube 에 들어가지 않으면 cube 를 그쪽으로 두 배씩 키우고
+    // 남은 삼각형을 모두 다시 배치한다 (번호는 그대로). 좌표가 유한하지 않으면 넣지 않고 -1
+    int insert(const Triangle& triangle);
+    void remove(int id);
+    void clear();
+
+    int getRoot() const { return root; }
+    const std::vector<Node>& getNodes() const { return nodes; }
+    const Triangle& getTriangle(int id) const { return triangles[id]; }
+    size_t getTriangleCapacity() const { return triangles.size(); }
+    size_t getTriangleCount() const { return root < 0 ? 0 : nodes[root].count; }
+    size_t getNodeCount() const { return nodes.size() - freeNodes.size(); }
+    size_t getMemoryUsage() const;
+
+private:
+    static uint64_t packCoord(const glm::ivec3& coord);
+
+    void setParams(float looseness, int maxLevel);
+    bool fitsCube(const AABB& box) const;
+    void grow(const AABB& box);
+    void placeAll();
+    void place(const Triangle& triangle, int& level, glm::ivec3& coord) const;
+    int findOrCreate(int level, const glm::ivec3& coord);
+    void addToNode(int node, int id);
+    void updateBounds(int node);
+
+    AABB cube;
+    float looseness = 2.0f;
+    int maxLevel = 5;
+    int root = -1;
+    std::vector<Node> nodes;
+    std::vector<int> freeNodes;
+    std::vector<std::unordered_map<uint64_t, int>> cells;  // level 마다 cell 좌표 -> 노드
+    std::vector<Triangle> triangles;
+    std::vector<int> triangleNodes;  // 삼각형 번호 -> 노드 (지운 번호는 -1)
+    std::vector<int> freeIds;
+};
+
+// 두 loose octree 의 삼각형 쌍을 정확히 한 번씩만 본다. 노드 쌍을 (자기 삼각형 | subtree) 조합으로 나눠 내려가므로
+// 내부 노드의 삼각형도 빠짐없이 검사한다. pairs 가 있으면 겹치는 (a 번호, b 번호) 를 모두 모으고, 없으면 처음 찾을 때 멈춘다
+bool collideLooseOctrees(const LooseOctree& a, const LooseOctree& b, const glm::mat4& bToA,
+    std::vector<std::pair<int, int>>* pairs = nullptr);
@@ -0,0 +1,79 @@
+﻿#include "mesh.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+struct VertexKey {
+    int64_t x, y, z;
+
+    bool operator==(const VertexKey& other) const {
+        return x == other.x && y == other.y && z == other.z;
+    }
+};
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey& key) const {
+        uint64_t h = static_cast<uint64_t>(key.x) * 0x9e3779b97f4a7c15ull;
+        h ^= static_cast<uint64_t>(key.y) * 0xc2b2ae3d27d4eb4full + (h << 6) + (h >> 2);
+        h ^= static_cast<uint64_t>(key.z) * 0x165667b19e3779f9ull + (h << 6) + (h >> 2);
+        return static_cast<size_t>(h);
+    }
+};
+
+VertexKey makeKey(const glm::vec3& p, float tolerance) {
+    VertexKey key;
+    if (tolerance > 0.0f) {
+        key.x = static_cast<int64_t>(std::floor(p.x / tolerance));
+        key.y = static_cast<int64_t>(std::floor(p.y / tolerance));
+        key.z = static_cast<int64_t>(std::floor(p.z / tolerance));
+    }
+    else {
+        // -0 과 +0 이 같은 key 가 되도록 0 을 더한 뒤 bit 를 비교한다
+        uint32_t bits[3];
+        float values[3] = { p.x + 0.0f, p.y + 0.0f, p.z + 0.0f };
+        std::memcpy(bits, values, sizeof(bits));
+        key.x = bits[0];
+        key.y = bits[1];
+        key.z = bits[2];
+    }
+    return key;
+}
+
+}
+
+IndexedMesh weldVertices(const std::vector<Triangle>& triangles, float tolerance) {
+    IndexedMesh mesh;
+    mesh.indices.reserve(triangles.size() * 3);
+
+    std::unordered_map<VertexKey, int, VertexKeyHash> lookup;
+    lookup.reserve(triangles.size());
+    for (const auto& tri : triangles) {
+        for (int i = 0; i < 3; ++i) {
+            auto result = lookup.emplace(makeKey(tri.vertices[i], tolerance), static_cast<int>(mesh.vertices.size()));
+            if (result.second) {
+                mesh.vertices.push_back(tri.vertices[i]);
+            }
+            mesh.indices.push_back(result.first->second);
+        }
+    }
+    mesh.bounds = calculateAABB(triangles);
+    return mesh;
+}
+
+std::vector<Triangle> toTriangles(const IndexedMesh& mesh) {
+    std::vector<Triangle> triangles(mesh.getTriangleCount());
+    for (size_t t = 0; t < triangles.size(); ++t) {
+        Triangle& tri = triangles[t];
+        for (int i = 0; i < 3; ++i) {
+            tri.vertices[i] = mesh.vertices[mesh.indices[t * 3 + i]];
+        }
+        glm::vec3 normal = glm::cross(tri.vertices[1] - tri.vertices[0], tri.vertices[2] - tri.vertices[0]);
+        float length = glm::length(normal);
+        tri.normal = length > 0.0f ? normal / length : glm::vec3(0.0f);
+    }
+    return triangles;
+}
@@ -0,0 +1,22 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm/glm.hpp>
+#include "geometry.h"
+
+// STL 은 삼각형마다 꼭짓점을 따로 저장하므로 같은 위치를 하나로 합친 index 형식.
+// 삼각형 t 는 indices[3t..3t+2] 이고 원래 삼각형 번호를 그대로 유지한다
+struct IndexedMesh {
+    std::vector<glm::vec3> vertices;
+    std::vector<int> indices;
+    AABB bounds;
+
+    size_t getTriangleCount() const { return indices.size() / 3; }
+};
+
+// tolerance 가 0 이면 좌표가 정확히 같은 꼭짓점만, 아니면 tolerance 크기 격자의 같은 칸에 든 꼭짓점을 합친다
+IndexedMesh weldVertices(const std::vector<Triangle>& triangles, float tolerance = 0.0f);
+
+// octree 를 만들 수 있도록 다시 삼각형 목록으로. normal 은 감김 방향으로 계산한다
+std::vector<Triangle> toTriangles(const IndexedMesh& mesh);
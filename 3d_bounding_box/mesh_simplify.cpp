@@ -0,0 +1,292 @@
+﻿#include "mesh_simplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// 경계 평면 quadric 의 가중치 (edge 길이 제곱에 곱한다)
+const double boundaryWeight = 100.0;
+
+// 대칭 4x4 행렬의 위쪽 10개: xx xy xz xw yy yz yw zz zw ww
+struct Quadric {
+    double q[10] = {};
+
+    static Quadric fromPlane(const glm::dvec3& n, double d, double weight) {
+        Quadric result;
+        double* q = result.q;
+        q[0] = n.x * n.x; q[1] = n.x * n.y; q[2] = n.x * n.z; q[3] = n.x * d;
+        q[4] = n.y * n.y; q[5] = n.y * n.z; q[6] = n.y * d;
+        q[7] = n.z * n.z; q[8] = n.z * d;
+        q[9] = d * d;
+        for (double& value : result.q) value *= weight;
+        return result;
+    }
+
+    Quadric& operator+=(const Quadric& other) {
+        for (int i = 0; i < 10; ++i) q[i] += other.q[i];
+        return *this;
+    }
+
+    double evaluate(const glm::dvec3& p) const {
+        return q[0] * p.x * p.x + 2.0 * q[1] * p.x * p.y + 2.0 * q[2] * p.x * p.z + 2.0 * q[3] * p.x +
+            q[4] * p.y * p.y + 2.0 * q[5] * p.y * p.z + 2.0 * q[6] * p.y +
+            q[7] * p.z * p.z + 2.0 * q[8] * p.z + q[9];
+    }
+
+    // 오차가 가장 작은 위치. 행렬이 거의 특이하면 (평면이 한 방향뿐이면) false
+    bool minimize(glm::dvec3& p) const {
+        glm::dmat3 a(q[0], q[1], q[2], q[1], q[4], q[5], q[2], q[5], q[7]);
+        double det = glm::determinant(a);
+        double scale = std::max(std::max(std::fabs(q[0]), std::fabs(q[4])), std::fabs(q[7]));
+        if (!(std::fabs(det) > 1e-9 * scale * scale * scale)) return false;
+        p = glm::inverse(a) * -glm::dvec3(q[3], q[6], q[8]);
+        return true;
+    }
+};
+
+struct Candidate {
+    float cost;
+    int v0, v1;
+    uint32_t stamp0, stamp1;
+
+    bool operator<(const Candidate& other) const { return cost > other.cost; }
+};
+
+inline uint64_t edgeKey(int a, int b) {
+    if (a > b) std::swap(a, b);
+    return (static_cast<uint64_t>(static_cast<uint32_t>(a)) << 32) | static_cast<uint32_t>(b);
+}
+
+class Simplifier {
+public:
+    explicit Simplifier(const IndexedMesh& mesh)
+        : positions(mesh.vertices), indices(mesh.indices),
+        quadrics(mesh.vertices.size()), stamps(mesh.vertices.size(), 0), vertexFaces(mesh.vertices.size()),
+        removedFaces(mesh.getTriangleCount(), 0), liveFaces(mesh.getTriangleCount()) {
+        std::unordered_map<uint64_t, int> edgeFaces;  // edge 를 쓰는 면 수 (1 이면 경계), 처음 면 번호는 따로
+        std::unordered_map<uint64_t, int> firstFace;
+        edgeFaces.reserve(indices.size());
+        firstFace.reserve(indices.size());
+
+        for (size_t f = 0; f < liveFaces; ++f) {
+            const int* v = &indices[f * 3];
+            glm::dvec3 a(positions[v[0]]), b(positions[v[1]]), c(positions[v[2]]);
+            glm::dvec3 normal = glm::cross(b - a, c - a);
+            double length = glm::length(normal);
+            if (length > 0.0) {
+                normal /= length;
+                Quadric plane = Quadric::fromPlane(normal, -glm::dot(normal, a), length * 0.5);
+                for (int i = 0; i < 3; ++i) quadrics[v[i]] += plane;
+            }
+
+            for (int i = 0; i < 3; ++i) {
+                vertexFaces[v[i]].push_back(static_cast<int>(f));
+                uint64_t key = edgeKey(v[i], v[(i + 1) % 3]);
+                if (++edgeFaces[key] == 1) firstFace[key] = static_cast<int>(f);
+            }
+        }
+
+        for (const auto& edge : edgeFaces) {
+            int v0 = static_cast<int>(edge.first >> 32);
+            int v1 = static_cast<int>(edge.first & 0xffffffffu);
+            if (edge.second == 1) {
+                addBoundaryQuadric(firstFace[edge.first], v0, v1);
+            }
+        }
+        for (const auto& edge : edgeFaces) {
+            pushCandidate(static_cast<int>(edge.first >> 32), static_cast<int>(edge.first & 0xffffffffu));
+        }
+    }
+
+    IndexedMesh run(size_t targetTriangles) {
+        std::vector<int> neighbors0, neighbors1;
+        while (liveFaces > targetTriangles && !heap.empty()) {
+            Candidate candidate = heap.top();
+            heap.pop();
+            int v0 = candidate.v0;
+            int v1 = candidate.v1;
+            if (stamps[v0] != candidate.stamp0 || stamps[v1] != candidate.stamp1) continue;
+
+            glm::vec3 position = optimalPosition(v0, v1);
+            if (!canCollapse(v0, v1, position, neighbors0, neighbors1)) continue;
+            collapse(v0, v1, position, neighbors0);
+        }
+        return compact();
+    }
+
+private:
+    void addBoundaryQuadric(int face, int v0, int v1) {
+        const int* v = &indices[face * 3];
+        glm::dvec3 a(positions[v[0]]), b(positions[v[1]]), c(positions[v[2]]);
+        glm::dvec3 faceNormal = glm::cross(b - a, c - a);
+        glm::dvec3 p0(positions[v0]);
+        glm::dvec3 edge = glm::dvec3(positions[v1]) - p0;
+        glm::dvec3 normal = glm::cross(edge, faceNormal);
+        double length = glm::length(normal);
+        if (!(length > 0.0)) return;
+
+        normal /= length;
+        Quadric plane = Quadric::fromPlane(normal, -glm::dot(normal, p0), boundaryWeight * glm::dot(edge, edge));
+        quadrics[v0] += plane;
+        quadrics[v1] += plane;
+    }
+
+    glm::vec3 optimalPosition(int v0, int v1) const {
+        Quadric q = quadrics[v0];
+        q += quadrics[v1];
+        glm::dvec3 p;
+        if (q.minimize(p) && std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z)) {
+            return glm::vec3(p);
+        }
+
+        // 풀 수 없으면 양 끝과 중점 중 가장 나은 곳
+        glm::dvec3 options[3] = { glm::dvec3(positions[v0]), glm::dvec3(positions[v1]),
+            (glm::dvec3(positions[v0]) + glm::dvec3(positions[v1])) * 0.5 };
+        int best = 0;
+        for (int i = 1; i < 3; ++i) {
+            if (q.evaluate(options[i]) < q.evaluate(options[best])) best = i;
+        }
+        return glm::vec3(options[best]);
+    }
+
+    void pushCandidate(int v0, int v1) {
+        Quadric q = quadrics[v0];
+        q += quadrics[v1];
+        Candidate candidate;
+        candidate.cost = static_cast<float>(std::max(q.evaluate(glm::dvec3(optimalPosition(v0, v1))), 0.0));
+        candidate.v0 = v0;
+        candidate.v1 = v1;
+        candidate.stamp0 = stamps[v0];
+        candidate.stamp1 = stamps[v1];
+        heap.push(candidate);
+    }
+
+    void collectNeighbors(int vertex, std::vector<int>& neighbors) const {
+        neighbors.clear();
+        for (int f : vertexFaces[vertex]) {
+            if (removedFaces[f]) continue;
+            for (int i = 0; i < 3; ++i) {
+                int v = indices[f * 3 + i];
+                if (v != vertex) neighbors.push_back(v);
+            }
+        }
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+    }
+
+    bool canCollapse(int v0, int v1, const glm::vec3& position, std::vector<int>& neighbors0, std::vector<int>& neighbors1) const {
+        // 공통 이웃은 두 꼭짓점을 함께 쓰는 면의 세 번째 꼭짓점뿐이어야 한다
+        collectNeighbors(v0, neighbors0);
+        collectNeighbors(v1, neighbors1);
+        size_t common = 0;
+        for (size_t i = 0, j = 0; i < neighbors0.size() && j < neighbors1.size();) {
+            if (neighbors0[i] < neighbors1[j]) ++i;
+            else if (neighbors0[i] > neighbors1[j]) ++j;
+            else { ++common; ++i; ++j; }
+        }
+        size_t shared = 0;
+        for (int f : vertexFaces[v0]) {
+            if (removedFaces[f]) continue;
+            const int* v = &indices[f * 3];
+            if (v[0] == v1 || v[1] == v1 || v[2] == v1) ++shared;
+        }
+        if (shared == 0 || common != shared) return false;
+
+        // 남는 면의 법선이 뒤집히지 않아야 한다
+        for (int vertex : { v0, v1 }) {
+            int other = vertex == v0 ? v1 : v0;
+            for (int f : vertexFaces[vertex]) {
+                if (removedFaces[f]) continue;
+                const int* v = &indices[f * 3];
+                if (v[0] == other || v[1] == other || v[2] == other) continue;
+
+                glm::vec3 before[3], after[3];
+                for (int i = 0; i < 3; ++i) {
+                    before[i] = positions[v[i]];
+                    after[i] = v[i] == vertex ? position : before[i];
+                }
+                glm::vec3 oldNormal = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 newNormal = glm::cross(after[1] - after[0], after[2] - after[0]);
+                if (glm::dot(oldNormal, newNormal) <= 0.0f) return false;
+            }
+        }
+        return true;
+    }
+
+    // v1 을 v0 으로 합친다. neighbors 는 canCollapse 가 모은 v0 의 이웃 (다시 쓰기 위해 재사용)
+    void collapse(int v0, int v1, const glm::vec3& position, std::vector<int>& neighbors) {
+        positions[v0] = position;
+        quadrics[v0] += quadrics[v1];
+        ++stamps[v0];
+        ++stamps[v1];
+
+        for (int f : vertexFaces[v1]) {
+            if (removedFaces[f]) continue;
+            int* v = &indices[f * 3];
+            if (v[0] == v0 || v[1] == v0 || v[2] == v0) {
+                removedFaces[f] = 1;
+                --liveFaces;
+                continue;
+            }
+            for (int i = 0; i < 3; ++i) {
+                if (v[i] == v1) v[i] = v0;
+            }
+            vertexFaces[v0].push_back(f);
+        }
+        std::vector<int>().swap(vertexFaces[v1]);
+
+        std::vector<int>& faces = vertexFaces[v0];
+        faces.erase(std::remove_if(faces.begin(), faces.end(), [&](int f) { return removedFaces[f] != 0; }), faces.end());
+
+        collectNeighbors(v0, neighbors);
+        for (int neighbor : neighbors) {
+            pushCandidate(v0, neighbor);
+        }
+    }
+
+    IndexedMesh compact() const {
+        IndexedMesh result;
+        std::vector<int> remap(positions.size(), -1);
+        for (size_t f = 0; f < removedFaces.size(); ++f) {
+            if (removedFaces[f]) continue;
+            for (int i = 0; i < 3; ++i) {
+                int v = indices[f * 3 + i];
+                if (remap[v] < 0) {
+                    remap[v] = static_cast<int>(result.vertices.size());
+                    result.vertices.push_back(positions[v]);
+                }
+                result.indices.push_back(remap[v]);
+            }
+        }
+
+        if (!result.vertices.empty()) {
+            result.bounds.min = result.bounds.max = result.vertices[0];
+            for (const auto& v : result.vertices) {
+                result.bounds.min = glm::min(result.bounds.min, v);
+                result.bounds.max = glm::max(result.bounds.max, v);
+            }
+        }
+        return result;
+    }
+
+    std::vector<glm::vec3> positions;
+    std::vector<int> indices;
+    std::vector<Quadric> quadrics;
+    std::vector<uint32_t> stamps;
+    std::vector<std::vector<int>> vertexFaces;
+    std::vector<uint8_t> removedFaces;
+    size_t liveFaces;
+    std::priority_queue<Candidate> heap;
+};
+
+}
+
+IndexedMesh simplifyMesh(const IndexedMesh& mesh, size_t targetTriangles) {
+    if (mesh.getTriangleCount() <= targetTriangles) return mesh;
+    return Simplifier(mesh).run(targetTriangles);
+}
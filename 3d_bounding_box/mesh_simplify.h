@@ -0,0 +1,10 @@
+﻿#pragma once
+
+#include <cstddef>
+#include "mesh.h"
+
+// Garland-Heckbert quadric error 로 비용이 가장 작은 edge 부터 합쳐 삼각형 수를 targetTriangles 이하로 줄인다.
+// 열린 경계 edge 에는 면에 수직인 평면 quadric 을 더해 테두리를 지키고, 면이 뒤집히거나
+// 두 꼭짓점의 공통 이웃이 공유 면보다 많아지는(접히는) collapse 는 건너뛴다.
+// 더 줄일 수 있는 edge 가 없으면 목표보다 많은 채로 끝난다. 결과 삼각형 번호는 원래 mesh 와 관계없다
+IndexedMesh simplifyMesh(const IndexedMesh& mesh, size_t targetTriangles);
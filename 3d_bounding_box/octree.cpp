@@ -0,0 +1,376 @@
+﻿#include "octree.h"
+
+#include <algorithm>
+#include <utility>
+#include "parallel.h"
+
+int maxDepth = 3;
+
+namespace {
+
+// 꼭짓점 하나라도 box 안에 있으면 그 cell 의 삼각형
+bool hasVertexIn(const Triangle& tri, const AABB& box) {
+    for (int j = 0; j < 3; ++j) {
+        if (tri.vertices[j].x >= box.min.x && tri.vertices[j].x <= box.max.x &&
+            tri.vertices[j].y >= box.min.y && tri.vertices[j].y <= box.max.y &&
+            tri.vertices[j].z >= box.min.z && tri.vertices[j].z <= box.max.z) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+std::vector<AABB> splitAABB(const AABB& box) {
+    std::vector<AABB> children(8);
+    glm::vec3 center = calculateCenter(box);
+
+    for (int i = 0; i < 8; ++i) {
+        children[i].min = glm::vec3(
+            (i & 1) ? center.x : box.min.x,
+            (i & 2) ? center.y : box.min.y,
+            (i & 4) ? center.z : box.min.z
+        );
+
+        children[i].max = glm::vec3(
+            (i & 1) ? box.max.x : center.x,
+            (i & 2) ? box.max.y : center.y,
+            (i & 4) ? box.max.z : center.z
+        );
+    }
+    return children;
+}
+
+OctreeNode* buildOctree(const AABB& box, const std::vector<Triangle>& triangles, int depth) {
+    std::vector<int> triangleIds(triangles.size());
+    for (size_t i = 0; i < triangles.size(); ++i) {
+        triangleIds[i] = static_cast<int>(i);
+    }
+    return buildOctree(box, triangles, triangleIds, depth);
+}
+
+OctreeNode* buildOctree(const AABB& box, const std::vector<Triangle>& triangles, const std::vector<int>& triangleIds, int depth) {
+    if (depth > maxDepth || triangles.empty()) {
+        return nullptr;
+    }
+
+    OctreeNode* node = new OctreeNode();
+    node->box = box;
+    node->bounds = calculateAABB(triangles);
+    node->triangles = triangles;
+    node->triangleIds = triangleIds;
+
+    if (depth == maxDepth) {
+        return node;
+    }
+
+    std::vector<AABB> childrenAABBs = splitAABB(box);
+    for (int i = 0; i < 8; ++i) {
+        std::vector<Triangle> childTriangles;
+        std::vector<int> childTriangleIds;
+
+        for (size_t t = 0; t < triangles.size(); ++t) {
+            if (hasVertexIn(triangles[t], childrenAABBs[i])) {
+                childTriangles.push_back(triangles[t]);
+                childTriangleIds.push_back(triangleIds[t]);
+            }
+        }
+
+        node->children[i] = buildOctree(childrenAABBs[i], childTriangles, childTriangleIds, depth + 1);
+    }
+
+    return node;
+}
+
+void deleteOctree(OctreeNode* node) {
+    // 자식 노드는 ~OctreeNode 에서 삭제
+    delete node;
+}
+
+namespace {
+
+// 복사 작업 하나가 맡는 삼각형 수
+const size_t refitGrain = 2048;
+
+struct RefitJob {
+    OctreeNode* node;
+    size_t begin, end;
+};
+
+float surfaceArea(const AABB& box) {
+    glm::vec3 size = box.max - box.min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+bool isInflated(const OctreeNode* node, float threshold) {
+    float boxArea = surfaceArea(node->box);
+    return boxArea > 0.0f && surfaceArea(node->bounds) > threshold * boxArea;
+}
+
+// 자식 중 하나라도 bounds 가 cell 을 많이 벗어난 가장 위쪽 노드들. 그 노드에서 다시 나눠야
+// 자리를 옮긴 삼각형이 맞는 자식으로 간다
+void collectInflated(OctreeNode* node, int depth, float threshold, std::vector<std::pair<OctreeNode*, int>>& inflated) {
+    if (!node || node->isLeaf()) return;
+
+    for (int i = 0; i < 8; ++i) {
+        if (node->children[i] && isInflated(node->children[i], threshold)) {
+            inflated.push_back(std::make_pair(node, depth));
+            return;
+        }
+    }
+    for (int i = 0; i < 8; ++i) {
+        collectInflated(node->children[i], depth + 1, threshold, inflated);
+    }
+}
+
+// node 의 삼각형으로 아래를 다시 만들어 자식만 바꿔 끼운다 (부모가 가진 포인터는 그대로)
+void rebuildSubtree(OctreeNode* node, int depth) {
+    AABB box = mergeAABB(node->box, node->bounds);
+    OctreeNode* fresh = buildOctree(box, node->triangles, node->triangleIds, depth);
+    for (int i = 0; i < 8; ++i) {
+        delete node->children[i];
+        node->children[i] = fresh->children[i];
+        fresh->children[i] = nullptr;
+    }
+    node->box = box;
+    delete fresh;
+}
+
+}
+
+size_t refitOctree(OctreeNode* root, const std::vector<Triangle>& triangles, float rebuildThreshold) {
+    if (!root) return 0;
+
+    // 부모가 자식보다 앞에 오는 순서로 노드를 모으고, 노드의 삼각형을 grain 단위 작업으로 나눈다
+    std::vector<OctreeNode*> nodes(1, root);
+    std::vector<RefitJob> jobs;
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        OctreeNode* node = nodes[n];
+        for (int i = 0; i < 8; ++i) {
+            if (node->children[i]) nodes.push_back(node->children[i]);
+        }
+        for (size_t begin = 0; begin < node->triangles.size(); begin += refitGrain) {
+            jobs.push_back({ node, begin, std::min(begin + refitGrain, node->triangles.size()) });
+        }
+    }
+
+    // leaf 작업만 자기 구간의 bounds 를 구한다. 내부 노드는 자식 bounds 를 합친다
+    std::vector<AABB> jobBounds(jobs.size());
+    parallelFor(jobs.size(), 1, [&](size_t begin, size_t end, unsigned) {
+        for (size_t j = begin; j < end; ++j) {
+            const RefitJob& job = jobs[j];
+            OctreeNode* node = job.node;
+            for (size_t i = job.begin; i < job.end; ++i) {
+                node->triangles[i] = triangles[node->triangleIds[i]];
+            }
+            if (!node->isLeaf()) continue;
+
+            AABB box;
+            box.min = box.max = node->triangles[job.begin].vertices[0];
+            for (size_t i = job.begin; i < job.end; ++i) {
+                for (int k = 0; k < 3; ++k) {
+                    box.min = glm::min(box.min, node->triangles[i].vertices[k]);
+                    box.max = glm::max(box.max, node->triangles[i].vertices[k]);
+                }
+            }
+            jobBounds[j] = box;
+        }
+    });
+
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        OctreeNode* node = jobs[j].node;
+        if (!node->isLeaf()) continue;
+        node->bounds = jobs[j].begin == 0 ? jobBounds[j] : mergeAABB(node->bounds, jobBounds[j]);
+    }
+    for (size_t n = nodes.size(); n-- > 0;) {
+        OctreeNode* node = nodes[n];
+        if (node->isLeaf()) continue;
+
+        bool first = true;
+        for (int i = 0; i < 8; ++i) {
+            if (!node->children[i]) continue;
+            node->bounds = first ? node->children[i]->bounds : mergeAABB(node->bounds, node->children[i]->bounds);
+            first = false;
+        }
+    }
+
+    if (rebuildThreshold <= 0.0f) return 0;
+
+    std::vector<std::pair<OctreeNode*, int>> inflated;
+    if (isInflated(root, rebuildThreshold)) {
+        inflated.push_back(std::make_pair(root, 0));
+    }
+    else {
+        collectInflated(root, 0, rebuildThreshold, inflated);
+    }
+    parallelFor(inflated.size(), 1, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; ++i) {
+            rebuildSubtree(inflated[i].first, inflated[i].second);
+        }
+    });
+    return inflated.size();
+}
+
+namespace {
+
+AABB triangleBounds(const Triangle& tri) {
+    AABB box;
+    box.min = glm::min(glm::min(tri.vertices[0], tri.vertices[1]), tri.vertices[2]);
+    box.max = glm::max(glm::max(tri.vertices[0], tri.vertices[1]), tri.vertices[2]);
+    return box;
+}
+
+// 자식이 있으면 그 box, 없으면 나눈 cell (refit 으로 넓어진 자식도 있어서 자식 box 를 우선한다)
+AABB childCell(const OctreeNode* node, int i) {
+    return node->children[i] ? node->children[i]->box : splitAABB(node->box)[i];
+}
+
+void addTriangle(OctreeNode* node, const Triangle& tri, int id) {
+    node->bounds = node->triangles.empty() ? triangleBounds(tri) : mergeAABB(node->bounds, triangleBounds(tri));
+    node->triangles.push_back(tri);
+    node->triangleIds.push_back(id);
+}
+
+// leaf 를 한 단계 나누고, 여전히 많은 자식은 다시 나눈다
+void splitLeaf(OctreeNode* node, int depth, const OctreeEditParams& params) {
+    std::vector<AABB> cells = splitAABB(node->box);
+    glm::vec3 center = calculateCenter(node->box);
+    auto addToChild = [&](int i, size_t t) {
+        if (!node->children[i]) {
+            node->children[i] = new OctreeNode();
+            node->children[i]->box = cells[i];
+        }
+        addTriangle(node->children[i], node->triangles[t], node->triangleIds[t]);
+    };
+
+    for (size_t t = 0; t < node->triangles.size(); ++t) {
+        const Triangle& tri = node->triangles[t];
+        bool placed = false;
+        for (int i = 0; i < 8; ++i) {
+            if (hasVertexIn(tri, cells[i])) {
+                addToChild(i, t);
+                placed = true;
+            }
+        }
+        // refit 으로 cell 밖에 나간 삼각형은 중심이 있는 쪽 자식에 둔다
+        if (!placed) {
+            glm::vec3 centroid = (tri.vertices[0] + tri.vertices[1] + tri.vertices[2]) / 3.0f;
+            addToChild((centroid.x > center.x ? 1 : 0) | (centroid.y > center.y ? 2 : 0) | (centroid.z > center.z ? 4 : 0), t);
+        }
+    }
+    for (int i = 0; i < 8; ++i) {
+        OctreeNode* child = node->children[i];
+        if (child && depth + 1 < maxDepth && child->triangles.size() > params.splitCount) {
+            splitLeaf(child, depth + 1, params);
+        }
+    }
+}
+
+// tri 는 node 의 cell 에 속한다
+void insertInto(OctreeNode* node, int depth, const Triangle& tri, int id, const OctreeEditParams& params) {
+    addTriangle(node, tri, id);
+    if (node->isLeaf()) {
+        if (depth < maxDepth && node->triangles.size() > params.splitCount) {
+            splitLeaf(node, depth, params);
+        }
+        return;
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        AABB cell = childCell(node, i);
+        if (!hasVertexIn(tri, cell)) continue;
+        if (!node->children[i]) {
+            node->children[i] = new OctreeNode();
+            node->children[i]->box = cell;
+        }
+        insertInto(node->children[i], depth + 1, tri, id, params);
+    }
+}
+
+// 자식의 삼각형은 부모 삼각형의 부분집합이라 node 에서 빠진 것이 없으면 아래도 볼 필요가 없다
+void removeFrom(OctreeNode*& node, const std::vector<int>& sortedIds, const OctreeEditParams& params) {
+    size_t kept = 0;
+    for (size_t t = 0; t < node->triangles.size(); ++t) {
+        if (std::binary_search(sortedIds.begin(), sortedIds.end(), node->triangleIds[t])) continue;
+        node->triangles[kept] = node->triangles[t];
+        node->triangleIds[kept] = node->triangleIds[t];
+        ++kept;
+    }
+    if (kept == node->triangles.size()) return;
+
+    node->triangles.resize(kept);
+    node->triangleIds.resize(kept);
+    if (kept == 0) {
+        delete node;
+        node = nullptr;
+        return;
+    }
+
+    if (!node->isLeaf()) {
+        // 내부 노드도 모든 삼각형을 갖고 있으므로 합칠 때는 자식만 지우면 된다
+        bool merge = kept < params.mergeCount;
+        for (int i = 0; i < 8; ++i) {
+            if (!node->children[i]) continue;
+            if (merge) {
+                delete node->children[i];
+                node->children[i] = nullptr;
+            }
+            else {
+                removeFrom(node->children[i], sortedIds, params);
+            }
+        }
+    }
+
+    if (node->isLeaf()) {
+        node->bounds = calculateAABB(node->triangles);
+        return;
+    }
+    bool first = true;
+    for (int i = 0; i < 8; ++i) {
+        if (!node->children[i]) continue;
+        node->bounds = first ? node->children[i]->bounds : mergeAABB(node->bounds, node->children[i]->bounds);
+        first = false;
+    }
+}
+
+}
+
+void insertTriangles(OctreeNode*& root, const std::vector<Triangle>& triangles, const std::vector<int>& ids,
+    const OctreeEditParams& params) {
+    if (triangles.empty()) return;
+    if (!root) {
+        root = buildOctree(calculateAABB(triangles), triangles, ids, 0);
+        return;
+    }
+
+    bool outside = false;
+    for (const auto& tri : triangles) {
+        if (!hasVertexIn(tri, root->box)) {
+            outside = true;
+            break;
+        }
+    }
+    if (outside) {
+        std::vector<Triangle> allTriangles = root->triangles;
+        std::vector<int> allIds = root->triangleIds;
+        allTriangles.insert(allTriangles.end(), triangles.begin(), triangles.end());
+        allIds.insert(allIds.end(), ids.begin(), ids.end());
+        AABB box = mergeAABB(root->box, calculateAABB(triangles));
+        deleteOctree(root);
+        root = buildOctree(box, allTriangles, allIds, 0);
+        return;
+    }
+
+    for (size_t t = 0; t < triangles.size(); ++t) {
+        insertInto(root, 0, triangles[t], ids[t], params);
+    }
+}
+
+void removeTriangles(OctreeNode*& root, const std::vector<int>& ids, const OctreeEditParams& params) {
+    if (!root || ids.empty()) return;
+
+    std::vector<int> sortedIds = ids;
+    std::sort(sortedIds.begin(), sortedIds.end());
+    removeFrom(root, sortedIds, params);
+}
@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include <vector>
+#include "geometry.h"
+
+struct OctreeNode {
+    AABB box;
+    AABB bounds;  // triangles 를 감싸는 box (cell 밖으로 나간 삼각형 포함)
+    std::vector<Triangle> triangles;
+    std::vector<int> triangleIds;  // 원본 mesh 에서의 삼각형 번호 (triangles 와 같은 순서)
+    OctreeNode* children[8] = { nullptr };
+
+    bool isLeaf() const {
+        for (int i = 0; i < 8; ++i) {
+            if (children[i]) return false;
+        }
+        return true;
+    }
+
+    ~OctreeNode() {
+        for (int i = 0; i < 8; ++i) {
+            delete children[i];
+        }
+    }
+};
+
+extern int maxDepth;
+
+// 편집 중 leaf 를 나누고 합치는 기준. 둘 사이를 벌려 두어 같은 자리에 넣고 빼기를 반복해도 매번 나누고 합치지 않는다
+struct OctreeEditParams {
+    size_t splitCount = 64;  // leaf 삼각형이 이보다 많아지면 (maxDepth 전까지) 나눈다
+    size_t mergeCount = 16;  // 내부 노드 삼각형이 이보다 적어지면 자식을 지우고 leaf 로 만든다
+};
+
+std::vector<AABB> splitAABB(const AABB& box);
+OctreeNode* buildOctree(const AABB& box, const std::vector<Triangle>& triangles, int depth);
+OctreeNode* buildOctree(const AABB& box, const std::vector<Triangle>& triangles, const std::vector<int>& triangleIds, int depth);
+void deleteOctree(OctreeNode* node);
+
+// 구조(triangleIds)는 그대로 두고 원본 순서의 triangles 에서 노드마다 삼각형을 다시 복사한 뒤 bounds 를 leaf 부터 다시 구한다.
+// rebuildThreshold > 0 이면 bounds 의 표면적이 box 의 threshold 배를 넘는 자식을 가진 가장 위쪽 노드(root 는 자신)를
+// box 를 bounds 까지 넓혀 그 아래만 다시 만든다. 다시 만든 subtree 수를 반환하며, 0 이 아니면 노드를 기억하는 CollisionFront 등은 reset 해야 한다
+size_t refitOctree(OctreeNode* root, const std::vector<Triangle>& triangles, float rebuildThreshold = 0.0f);
+
+// 기존 octree 에 삼각형을 넣는다. ids 는 호출하는 쪽이 정하는 번호 (triangleIds 에 그대로 들어간다).
+// root 가 nullptr 이면 새로 만들고, root box 밖의 삼각형이 있으면 box 를 넓혀 전체를 다시 만든다
+void insertTriangles(OctreeNode*& root, const std::vector<Triangle>& triangles, const std::vector<int>& ids,
+    const OctreeEditParams& params = OctreeEditParams());
+// ids 에 해당하는 삼각형을 모든 노드에서 뺀다. 비는 노드는 지우고 (root 도 비면 nullptr)
+// 적게 남은 내부 노드는 leaf 로 합친다. 편집 뒤에는 노드와 삼각형 번호를 기억하는 CollisionFront 등을 reset 해야 한다
+void removeTriangles(OctreeNode*& root, const std::vector<int>& ids, const OctreeEditParams& params = OctreeEditParams());
@@ -0,0 +1,50 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+inline unsigned getWorkerCount() {
+    unsigned count = std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
+
+// [0, count) 를 grainSize 단위로 나누어 worker 스레드에 동적으로 분배한다.
+// func(begin, end, worker) 의 worker 는 0..getWorkerCount()-1 이므로
+// 스레드별 임시 버퍼의 인덱스로 쓸 수 있다.
+template <typename Func>
+void parallelFor(size_t count, size_t grainSize, Func func) {
+    if (count == 0) return;
+    grainSize = std::max<size_t>(grainSize, 1);
+
+    size_t chunkCount = (count + grainSize - 1) / grainSize;
+    unsigned workerCount = static_cast<unsigned>(std::min<size_t>(getWorkerCount(), chunkCount));
+    if (workerCount <= 1) {
+        for (size_t begin = 0; begin < count; begin += grainSize) {
+            func(begin, std::min(begin + grainSize, count), 0u);
+        }
+        return;
+    }
+
+    std::atomic<size_t> nextChunk(0);
+    auto worker = [&](unsigned workerIndex) {
+        for (;;) {
+            size_t chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+            if (chunk >= chunkCount) break;
+            size_t begin = chunk * grainSize;
+            size_t end = std::min(begin + grainSize, count);
+            func(begin, end, workerIndex);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workerCount - 1);
+    for (unsigned i = 1; i < workerCount; ++i) {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
@@ -0,0 +1,306 @@
+﻿#include "ray_packet.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "aabb_simd.h"
+#include "parallel.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define RAY_PACKET_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RAY_PACKET_SSE
+#endif
+
+namespace {
+
+// lane 폭만큼의 float 연산. AVX 는 8, SSE 는 4, 둘 다 없으면 1
+#if defined(RAY_PACKET_AVX)
+const int laneWidth = 8;
+typedef __m256 Lanes;
+inline Lanes load(const float* p) { return _mm256_load_ps(p); }
+inline void store(float* p, Lanes a) { _mm256_store_ps(p, a); }
+inline Lanes broadcast(float a) { return _mm256_set1_ps(a); }
+inline Lanes add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+inline Lanes sub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+inline Lanes mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+inline Lanes div(Lanes a, Lanes b) { return _mm256_div_ps(a, b); }
+inline Lanes minLanes(Lanes a, Lanes b) { return _mm256_min_ps(a, b); }
+inline Lanes maxLanes(Lanes a, Lanes b) { return _mm256_max_ps(a, b); }
+inline Lanes lessEqual(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+inline Lanes greater(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+inline Lanes unordered(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_UNORD_Q); }
+inline Lanes both(Lanes a, Lanes b) { return _mm256_and_ps(a, b); }
+inline Lanes select(Lanes mask, Lanes a, Lanes b) { return _mm256_blendv_ps(b, a, mask); }
+inline Lanes absLanes(Lanes a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+inline unsigned maskOf(Lanes a) { return static_cast<unsigned>(_mm256_movemask_ps(a)); }
+#elif defined(RAY_PACKET_SSE)
+const int laneWidth = 4;
+typedef __m128 Lanes;
+inline Lanes load(const float* p) { return _mm_load_ps(p); }
+inline void store(float* p, Lanes a) { _mm_store_ps(p, a); }
+inline Lanes broadcast(float a) { return _mm_set1_ps(a); }
+inline Lanes add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+inline Lanes sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+inline Lanes mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+inline Lanes div(Lanes a, Lanes b) { return _mm_div_ps(a, b); }
+inline Lanes minLanes(Lanes a, Lanes b) { return _mm_min_ps(a, b); }
+inline Lanes maxLanes(Lanes a, Lanes b) { return _mm_max_ps(a, b); }
+inline Lanes lessEqual(Lanes a, Lanes b) { return _mm_cmple_ps(a, b); }
+inline Lanes greater(Lanes a, Lanes b) { return _mm_cmpgt_ps(a, b); }
+inline Lanes unordered(Lanes a, Lanes b) { return _mm_cmpunord_ps(a, b); }
+inline Lanes both(Lanes a, Lanes b) { return _mm_and_ps(a, b); }
+inline Lanes select(Lanes mask, Lanes a, Lanes b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+inline Lanes absLanes(Lanes a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+inline unsigned maskOf(Lanes a) { return static_cast<unsigned>(_mm_movemask_ps(a)); }
+#else
+const int laneWidth = 1;
+struct Lanes {
+    float value;
+    bool mask;
+};
+inline Lanes load(const float* p) { return { *p, false }; }
+inline void store(float* p, Lanes a) { *p = a.value; }
+inline Lanes broadcast(float a) { return { a, false }; }
+inline Lanes add(Lanes a, Lanes b) { return { a.value + b.value, false }; }
+inline Lanes sub(Lanes a, Lanes b) { return { a.value - b.value, false }; }
+inline Lanes mul(Lanes a, Lanes b) { return { a.value * b.value, false }; }
+inline Lanes div(Lanes a, Lanes b) { return { a.value / b.value, false }; }
+inline Lanes minLanes(Lanes a, Lanes b) { return { a.value < b.value ? a.value : b.value, false }; }
+inline Lanes maxLanes(Lanes a, Lanes b) { return { a.value > b.value ? a.value : b.value, false }; }
+inline Lanes lessEqual(Lanes a, Lanes b) { return { 0.0f, a.value <= b.value }; }
+inline Lanes greater(Lanes a, Lanes b) { return { 0.0f, a.value > b.value }; }
+inline Lanes unordered(Lanes a, Lanes b) { return { 0.0f, a.value != a.value || b.value != b.value }; }
+inline Lanes both(Lanes a, Lanes b) { return { 0.0f, a.mask && b.mask }; }
+inline Lanes select(Lanes mask, Lanes a, Lanes b) { return mask.mask ? a : b; }
+inline Lanes absLanes(Lanes a) { return { a.value < 0.0f ? -a.value : a.value, false }; }
+inline unsigned maskOf(Lanes a) { return a.mask ? 1u : 0u; }
+#endif
+
+// 광선을 축별로 나눠 담는다. best 는 지금까지 가장 가까운 교차 거리(처음에는 tMax)
+struct alignas(32) Packet {
+    float originX[maxPacketSize], originY[maxPacketSize], originZ[maxPacketSize];
+    float dirX[maxPacketSize], dirY[maxPacketSize], dirZ[maxPacketSize];
+    float invX[maxPacketSize], invY[maxPacketSize], invZ[maxPacketSize];
+    float best[maxPacketSize];
+    float u[maxPacketSize], v[maxPacketSize];
+    int triangle[maxPacketSize];
+};
+
+struct PacketEntry {
+    const OctreeNode* node;
+    unsigned active;
+};
+
+inline int bitCount(unsigned mask) {
+    int count = 0;
+    for (; mask; mask &= mask - 1) {
+        ++count;
+    }
+    return count;
+}
+
+inline unsigned laneMask(unsigned active, int offset) {
+    return (active >> offset) & ((1u << laneWidth) - 1);
+}
+
+// 한 축의 slab 구간으로 [tNear, tFar] 를 좁힌다. 방향 성분이 0 이고 원점이 slab 면 위에 있으면
+// 0 * inf = NaN 이 되는데, 그 광선은 면 위를 지나므로 (닿으면 겹침) 그 축은 구간을 좁히지 않는다
+inline void clipSlab(Lanes t1, Lanes t2, Lanes& tNear, Lanes& tFar) {
+    Lanes onFace = unordered(t1, t2);
+    tNear = maxLanes(tNear, select(onFace, tNear, minLanes(t1, t2)));
+    tFar = minLanes(tFar, select(onFace, tFar, maxLanes(t1, t2)));
+}
+
+// active 중 box 와 [0, best] 에서 만나는 광선의 mask
+unsigned slabMask(const Packet& packet, const AABB& box, unsigned active) {
+    Lanes minX = broadcast(box.min.x), minY = broadcast(box.min.y), minZ = broadcast(box.min.z);
+    Lanes maxX = broadcast(box.max.x), maxY = broadcast(box.max.y), maxZ = broadcast(box.max.z);
+
+    unsigned result = 0;
+    for (int offset = 0; offset < static_cast<int>(maxPacketSize); offset += laneWidth) {
+        if (!laneMask(active, offset)) continue;
+
+        Lanes tNear = broadcast(0.0f);
+        Lanes tFar = load(packet.best + offset);
+
+        Lanes ox = load(packet.originX + offset), ix = load(packet.invX + offset);
+        clipSlab(mul(sub(minX, ox), ix), mul(sub(maxX, ox), ix), tNear, tFar);
+
+        Lanes oy = load(packet.originY + offset), iy = load(packet.invY + offset);
+        clipSlab(mul(sub(minY, oy), iy), mul(sub(maxY, oy), iy), tNear, tFar);
+
+        Lanes oz = load(packet.originZ + offset), iz = load(packet.invZ + offset);
+        clipSlab(mul(sub(minZ, oz), iz), mul(sub(maxZ, oz), iz), tNear, tFar);
+
+        result |= maskOf(lessEqual(tNear, tFar)) << offset;
+    }
+    return result & active;
+}
+
+// 삼각형 하나를 여러 광선에 대해 Möller-Trumbore 로 검사한다
+void intersectLeaf(Packet& packet, const OctreeNode* leaf, unsigned active) {
+    alignas(32) float t[laneWidth], u[laneWidth], v[laneWidth];
+    const Lanes zero = broadcast(0.0f);
+    const Lanes one = broadcast(1.0f);
+    const Lanes epsilon = broadcast(1e-8f);
+
+    for (size_t k = 0; k < leaf->triangles.size(); ++k) {
+        const glm::vec3* vertices = leaf->triangles[k].vertices;
+        glm::vec3 e1 = vertices[1] - vertices[0];
+        glm::vec3 e2 = vertices[2] - vertices[0];
+        Lanes e1x = broadcast(e1.x), e1y = broadcast(e1.y), e1z = broadcast(e1.z);
+        Lanes e2x = broadcast(e2.x), e2y = broadcast(e2.y), e2z = broadcast(e2.z);
+        Lanes v0x = broadcast(vertices[0].x), v0y = broadcast(vertices[0].y), v0z = broadcast(vertices[0].z);
+
+        for (int offset = 0; offset < static_cast<int>(maxPacketSize); offset += laneWidth) {
+            unsigned lanes = laneMask(active, offset);
+            if (!lanes) continue;
+
+            Lanes dx = load(packet.dirX + offset), dy = load(packet.dirY + offset), dz = load(packet.dirZ + offset);
+
+            // p = d x e2, det = e1 . p
+            Lanes px = sub(mul(dy, e2z), mul(dz, e2y));
+            Lanes py = sub(mul(dz, e2x), mul(dx, e2z));
+            Lanes pz = sub(mul(dx, e2y), mul(dy, e2x));
+            Lanes det = add(add(mul(e1x, px), mul(e1y, py)), mul(e1z, pz));
+            Lanes invDet = div(one, det);
+
+            Lanes sx = sub(load(packet.originX + offset), v0x);
+            Lanes sy = sub(load(packet.originY + offset), v0y);
+            Lanes sz = sub(load(packet.originZ + offset), v0z);
+            Lanes uu = mul(add(add(mul(sx, px), mul(sy, py)), mul(sz, pz)), invDet);
+
+            // q = s x e1
+            Lanes qx = sub(mul(sy, e1z), mul(sz, e1y));
+            Lanes qy = sub(mul(sz, e1x), mul(sx, e1z));
+            Lanes qz = sub(mul(sx, e1y), mul(sy, e1x));
+            Lanes vv = mul(add(add(mul(dx, qx), mul(dy, qy)), mul(dz, qz)), invDet);
+            Lanes tt = mul(add(add(mul(e2x, qx), mul(e2y, qy)), mul(e2z, qz)), invDet);
+
+            Lanes hit = greater(absLanes(det), epsilon);
+            hit = both(hit, lessEqual(zero, uu));
+            hit = both(hit, lessEqual(zero, vv));
+            hit = both(hit, lessEqual(add(uu, vv), one));
+            hit = both(hit, lessEqual(zero, tt));
+            hit = both(hit, lessEqual(tt, load(packet.best + offset)));
+
+            unsigned hitMask = maskOf(hit) & lanes;
+            if (!hitMask) continue;
+
+            store(t, tt);
+            store(u, uu);
+            store(v, vv);
+            while (hitMask) {
+                int lane = lowestBit(hitMask);
+                hitMask &= hitMask - 1;
+                int ray = offset + lane;
+                packet.best[ray] = t[lane];
+                packet.u[ray] = u[lane];
+                packet.v[ray] = v[lane];
+                packet.triangle[ray] = leaf->triangleIds[k];
+            }
+        }
+    }
+}
+
+}
+
+void raycastPacket(const OctreeNode* tree, const Ray* rays, size_t count, RayHit* hits) {
+    count = std::min(count, maxPacketSize);
+    if (count == 0) return;
+
+    Packet packet;
+    glm::vec3 averageDirection(0.0f);
+    for (size_t i = 0; i < maxPacketSize; ++i) {
+        // 남는 lane 은 best 를 음수로 두어 어떤 box 와도 만나지 않게 한다
+        const Ray& ray = rays[i < count ? i : 0];
+        glm::vec3 inv = 1.0f / ray.direction;
+        packet.originX[i] = ray.origin.x;
+        packet.originY[i] = ray.origin.y;
+        packet.originZ[i] = ray.origin.z;
+        packet.dirX[i] = ray.direction.x;
+        packet.dirY[i] = ray.direction.y;
+        packet.dirZ[i] = ray.direction.z;
+        packet.invX[i] = inv.x;
+        packet.invY[i] = inv.y;
+        packet.invZ[i] = inv.z;
+        packet.best[i] = i < count ? ray.tMax : -1.0f;
+        packet.u[i] = packet.v[i] = 0.0f;
+        packet.triangle[i] = -1;
+        if (i < count) {
+            averageDirection += ray.direction;
+        }
+    }
+
+    // 평균 방향의 부호로 자식 방문 순서를 정한다 (광선이 들어오는 쪽 자식이 먼저)
+    int nearChild = (averageDirection.x < 0.0f ? 1 : 0) | (averageDirection.y < 0.0f ? 2 : 0) |
+        (averageDirection.z < 0.0f ? 4 : 0);
+    unsigned allLanes = (1u << count) - 1;
+    int divergedCount = std::max<int>(1, static_cast<int>(count) / 4);
+
+    thread_local std::vector<PacketEntry> stack;
+    stack.clear();
+    if (tree) {
+        stack.push_back({ tree, allLanes });
+    }
+
+    while (!stack.empty()) {
+        PacketEntry entry = stack.back();
+        stack.pop_back();
+
+        // push 이후 best 가 줄었을 수 있으므로 꺼낼 때 검사한다. 모두 빠지면 subtree 를 건너뛴다
+        unsigned active = slabMask(packet, entry.node->bounds, entry.active);
+        if (!active) continue;
+
+        if (entry.node->isLeaf()) {
+            intersectLeaf(packet, entry.node, active);
+            continue;
+        }
+
+        if (bitCount(active) <= divergedCount) {
+            while (active) {
+                int i = lowestBit(active);
+                active &= active - 1;
+
+                RayHit hit;
+                hit.triangle = packet.triangle[i];
+                hit.distance = packet.best[i];
+                hit.barycentric = glm::vec2(packet.u[i], packet.v[i]);
+                if (raycastFrom(entry.node, rays[i].origin, rays[i].direction, hit)) {
+                    packet.triangle[i] = hit.triangle;
+                    packet.best[i] = hit.distance;
+                    packet.u[i] = hit.barycentric.x;
+                    packet.v[i] = hit.barycentric.y;
+                }
+            }
+            continue;
+        }
+
+        for (int i = 7; i >= 0; --i) {
+            const OctreeNode* child = entry.node->children[i ^ nearChild];
+            if (child) {
+                stack.push_back({ child, active });
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        hits[i].triangle = packet.triangle[i];
+        hits[i].distance = packet.best[i];
+        hits[i].barycentric = glm::vec2(packet.u[i], packet.v[i]);
+    }
+}
+
+void raycastPackets(const OctreeNode* tree, const Ray* rays, size_t count, RayHit* hits, size_t packetSize) {
+    packetSize = std::max<size_t>(1, std::min(packetSize, maxPacketSize));
+    size_t packetCount = (count + packetSize - 1) / packetSize;
+    parallelFor(packetCount, 16, [&](size_t begin, size_t end, unsigned) {
+        for (size_t p = begin; p < end; ++p) {
+            size_t first = p * packetSize;
+            raycastPacket(tree, rays + first, std::min(packetSize, count - first), hits + first);
+        }
+    });
+}
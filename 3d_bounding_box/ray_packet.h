@@ -0,0 +1,16 @@
+﻿#pragma once
+
+#include <cstddef>
+#include "octree.h"
+#include "raycast.h"
+
+const size_t maxPacketSize = 16;
+
+// 방향이 비슷한 광선 묶음(최대 maxPacketSize 개)을 한 번에 탐색한다. 노드마다 slab test 를
+// SIMD 로 여러 광선에 동시에 하고, 살아 있는 광선이 없으면 그 subtree 를 건너뛴다.
+// 살아 있는 광선이 packet 의 1/4 이하로 줄면 그 광선들만 raycastFrom 으로 따로 내려간다.
+void raycastPacket(const OctreeNode* tree, const Ray* rays, size_t count, RayHit* hits);
+
+// rays 를 앞에서부터 packetSize(4, 8, 16) 개씩 묶어 스레드에 나눈다.
+// 깊이 카메라의 tile 처럼 이웃한 광선이 인접하게 놓여 있어야 효과가 있다.
+void raycastPackets(const OctreeNode* tree, const Ray* rays, size_t count, RayHit* hits, size_t packetSize = 8);
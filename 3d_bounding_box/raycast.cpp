@@ -0,0 +1,132 @@
+﻿#include "raycast.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "parallel.h"
+
+namespace {
+
+struct StackEntry {
+    const OctreeNode* node;
+    float tNear;
+};
+
+}
+
+bool intersectRayAABB(const glm::vec3& origin, const glm::vec3& invDirection, const AABB& box, float tMax, float& tNear) {
+    // 방향 성분이 0 이고 원점이 slab 면 위에 있으면 0 * inf = NaN 이 된다.
+    // 그 광선은 면 위를 지나므로 (닿으면 겹침) 그 축은 구간을 좁히지 않는다
+    float tMin = 0.0f;
+    float tFar = tMax;
+    for (int axis = 0; axis < 3; ++axis) {
+        float t1 = (box.min[axis] - origin[axis]) * invDirection[axis];
+        float t2 = (box.max[axis] - origin[axis]) * invDirection[axis];
+        if (std::isnan(t1) || std::isnan(t2)) continue;
+        tMin = std::max(tMin, std::min(t1, t2));
+        tFar = std::min(tFar, std::max(t1, t2));
+    }
+    tNear = tMin;
+    return tMin <= tFar;
+}
+
+bool intersectRayTriangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3 vertices[3],
+    float& t, glm::vec2& barycentric) {
+    const float epsilon = 1e-8f;
+
+    glm::vec3 edge1 = vertices[1] - vertices[0];
+    glm::vec3 edge2 = vertices[2] - vertices[0];
+    glm::vec3 p = glm::cross(direction, edge2);
+    float det = glm::dot(edge1, p);
+    if (std::abs(det) < epsilon) {
+        return false;
+    }
+
+    float invDet = 1.0f / det;
+    glm::vec3 s = origin - vertices[0];
+    float u = glm::dot(s, p) * invDet;
+    if (u < 0.0f || u > 1.0f) {
+        return false;
+    }
+
+    glm::vec3 q = glm::cross(s, edge1);
+    float v = glm::dot(direction, q) * invDet;
+    if (v < 0.0f || u + v > 1.0f) {
+        return false;
+    }
+
+    t = glm::dot(edge2, q) * invDet;
+    barycentric = glm::vec2(u, v);
+    return true;
+}
+
+bool raycastFrom(const OctreeNode* node, const glm::vec3& origin, const glm::vec3& direction, RayHit& hit) {
+    glm::vec3 invDirection = 1.0f / direction;
+    float tNear;
+    if (!node || !intersectRayAABB(origin, invDirection, node->bounds, hit.distance, tNear)) {
+        return false;
+    }
+
+    // 광선마다 할당하지 않도록 스레드별 stack 을 재사용한다
+    thread_local std::vector<StackEntry> stack;
+    stack.clear();
+    stack.push_back({ node, tNear });
+
+    bool found = false;
+    while (!stack.empty()) {
+        StackEntry entry = stack.back();
+        stack.pop_back();
+        if (entry.tNear > hit.distance) {
+            continue;
+        }
+
+        node = entry.node;
+        if (node->isLeaf()) {
+            for (size_t i = 0; i < node->triangles.size(); ++i) {
+                float t;
+                glm::vec2 barycentric;
+                if (intersectRayTriangle(origin, direction, node->triangles[i].vertices, t, barycentric) &&
+                    t >= 0.0f && t <= hit.distance) {
+                    hit.triangle = node->triangleIds[i];
+                    hit.distance = t;
+                    hit.barycentric = barycentric;
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // 맞은 자식을 진입 거리 내림차순으로 쌓아 가까운 자식이 먼저 나오게 한다
+        StackEntry children[8];
+        int childCount = 0;
+        for (int i = 0; i < 8; ++i) {
+            const OctreeNode* child = node->children[i];
+            if (child && intersectRayAABB(origin, invDirection, child->bounds, hit.distance, tNear)) {
+                int j = childCount++;
+                while (j > 0 && children[j - 1].tNear < tNear) {
+                    children[j] = children[j - 1];
+                    --j;
+                }
+                children[j] = { child, tNear };
+            }
+        }
+        stack.insert(stack.end(), children, children + childCount);
+    }
+
+    return found;
+}
+
+RayHit raycast(const OctreeNode* tree, const glm::vec3& origin, const glm::vec3& direction, float tMax) {
+    RayHit hit;
+    hit.distance = tMax;
+    raycastFrom(tree, origin, direction, hit);
+    return hit;
+}
+
+void raycastBatch(const OctreeNode* tree, const Ray* rays, size_t count, RayHit* hits) {
+    parallelFor(count, 256, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; ++i) {
+            hits[i] = raycast(tree, rays[i].origin, rays[i].direction, rays[i].tMax);
+        }
+    });
+}
@@ -0,0 +1,38 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <glm/glm/glm.hpp>
+#include "geometry.h"
+#include "octree.h"
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float tMax;
+};
+
+// triangle 은 buildOctree 에 넘긴 삼각형 번호, 맞지 않았으면 -1.
+// 교차점 = (1 - u - v) * v0 + u * v1 + v * v2, distance 는 direction 길이 단위의 t
+struct RayHit {
+    int triangle = -1;
+    float distance = 0.0f;
+    glm::vec2 barycentric = glm::vec2(0.0f);
+
+    bool hit() const { return triangle >= 0; }
+};
+
+// slab test. invDirection = 1 / direction 이고 [0, tMax] 구간과 겹치면 진입 t 를 tNear 에 넣는다
+bool intersectRayAABB(const glm::vec3& origin, const glm::vec3& invDirection, const AABB& box, float tMax, float& tNear);
+
+// Möller-Trumbore. 양면 모두 검사한다
+bool intersectRayTriangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3 vertices[3],
+    float& t, glm::vec2& barycentric);
+
+// [0, tMax] 에서 가장 가까운 삼각형. 노드 bounds 에 slab test 를 하고 가까운 자식부터 내려간다
+RayHit raycast(const OctreeNode* tree, const glm::vec3& origin, const glm::vec3& direction, float tMax);
+
+// node 아래에서 hit.distance 보다 가까운 교차를 찾으면 hit 를 갱신하고 true
+bool raycastFrom(const OctreeNode* node, const glm::vec3& origin, const glm::vec3& direction, RayHit& hit);
+
+// 광선 여러 개를 스레드에 나눠 검사한다. hits 는 count 개 이상이어야 한다
+void raycastBatch(const OctreeNode* tree, const Ray* rays, size_t count, RayHit* hits);
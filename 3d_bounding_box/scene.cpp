@@ -0,0 +1,255 @@
+﻿#include "scene.h"
+
+#include <algorithm>
+#include <glm/glm/gtc/matrix_transform.hpp>
+#include "convex_hull.h"
+
+namespace {
+
+void updateHull(Mesh& mesh) {
+    if (!mesh.hullDirty) return;
+    mesh.welded = weldVertices(mesh.triangles);
+    mesh.hull = computeConvexHull(mesh.welded);
+    mesh.hullDirty = false;
+}
+
+// 대각선의 1/64 간격, 대각선의 1/8 안쪽만 표본을 둔다. 더 깊은 접촉은 computeContacts 가 octree 로 보정한다
+void updateDistanceField(Mesh& mesh) {
+    if (!mesh.distanceFieldDirty) return;
+    float diagonal = glm::length(mesh.box.max - mesh.box.min);
+    mesh.distanceField.build(mesh.octree, diagonal / 64.0f, diagonal / 8.0f);
+    mesh.distanceFieldDirty = false;
+}
+
+}
+
+Scene::~Scene() {
+    for (auto& mesh : meshes) {
+        deleteOctree(mesh.octree);
+    }
+}
+
+int Scene::addMesh(const std::vector<Triangle>& triangles) {
+    Mesh mesh;
+    mesh.triangles = triangles;
+    mesh.box = calculateAABB(triangles);
+    mesh.octree = buildOctree(mesh.box, mesh.triangles, 0);
+    mesh.hullDirty = true;
+    mesh.distanceFieldDirty = true;
+    updateHull(mesh);
+    updateDistanceField(mesh);
+    meshes.push_back(std::move(mesh));
+    return static_cast<int>(meshes.size()) - 1;
+}
+
+void Scene::updateMeshTriangles(int mesh, const std::vector<Triangle>& triangles) {
+    Mesh& m = meshes[mesh];
+    m.triangles = triangles;
+    refitOctree(m.octree, m.triangles, refitRebuildThreshold);
+    m.box = m.octree ? m.octree->bounds : calculateAABB(m.triangles);
+    m.hullDirty = true;
+    m.distanceFieldDirty = true;
+
+    // 이 mesh 를 쓰는 instance 의 world box 를 갱신하고, 옛 삼각형과 노드를 기억하는 front 와 simplex 는 버린다
+    for (size_t i = 0; i < instances.size(); ++i) {
+        if (instances[i].mesh == mesh) {
+            setTransform(static_cast<int>(i), instances[i].transform);
+        }
+    }
+    for (auto& entry : collisionFronts) {
+        if (instances[entry.first.first].mesh == mesh || instances[entry.first.second].mesh == mesh) {
+            entry.second.reset();
+        }
+    }
+    for (auto it = gjkCaches.begin(); it != gjkCaches.end();) {
+        if (instances[it->first.first].mesh == mesh || instances[it->first.second].mesh == mesh) {
+            it = gjkCaches.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+int Scene::addInstance(int mesh, const glm::mat4& transform) {
+    MeshInstance instance;
+    instance.mesh = mesh;
+    instance.transform = transform;
+    instance.worldBox = transformAABB(meshes[mesh].box, transform);
+    instance.proxy = sweepAndPrune.addBox(instance.worldBox);
+
+    if (instance.proxy >= static_cast<int>(proxyToInstance.size())) {
+        proxyToInstance.resize(instance.proxy + 1, -1);
+    }
+    proxyToInstance[instance.proxy] = static_cast<int>(instances.size());
+    instance.treeProxy = dynamicTree.createProxy(instance.worldBox, static_cast<int>(instances.size()));
+
+    instances.push_back(instance);
+    return static_cast<int>(instances.size()) - 1;
+}
+
+void Scene::setTransform(int instance, const glm::mat4& transform) {
+    MeshInstance& inst = instances[instance];
+    glm::vec3 displacement = glm::vec3(transform[3]) - glm::vec3(inst.transform[3]);
+    inst.transform = transform;
+    inst.worldBox = transformAABB(meshes[inst.mesh].box, transform);
+    sweepAndPrune.updateBox(inst.proxy, inst.worldBox);
+    dynamicTree.moveProxy(inst.treeProxy, inst.worldBox, displacement);
+}
+
+void Scene::translateInstance(int instance, const glm::vec3& delta) {
+    setTransform(instance, glm::translate(glm::mat4(1.0f), delta) * instances[instance].transform);
+}
+
+void Scene::update() {
+    updateBroadPhase();
+    updateNarrowPhase();
+}
+
+void Scene::updateBroadPhase() {
+    switch (broadPhase) {
+    case BroadPhaseType::SweepAndPrune:
+        sweepAndPrune.update();
+        sweepAndPrune.getPairs(candidatePairs);
+        for (auto& pair : candidatePairs) {
+            pair.first = proxyToInstance[pair.first];
+            pair.second = proxyToInstance[pair.second];
+            if (pair.first > pair.second) std::swap(pair.first, pair.second);
+        }
+        break;
+
+    case BroadPhaseType::SpatialHash:
+        worldBoxes.resize(instances.size());
+        for (size_t i = 0; i < instances.size(); ++i) {
+            worldBoxes[i] = instances[i].worldBox;
+        }
+        spatialHash.build(worldBoxes);
+        spatialHash.getPairs(candidatePairs);
+        break;
+
+    case BroadPhaseType::DynamicTree:
+        // 다시 삽입된 leaf 만 질의하고, fat box 가 더 이상 겹치지 않는 쌍은 버린다
+        dynamicTree.updatePairs([this](int a, int b) {
+            dynamicTreePairs.insert(std::make_pair(std::min(a, b), std::max(a, b)));
+        });
+
+        candidatePairs.clear();
+        for (auto it = dynamicTreePairs.begin(); it != dynamicTreePairs.end();) {
+            const MeshInstance& a = instances[it->first];
+            const MeshInstance& b = instances[it->second];
+            if (!checkAABBCollision(dynamicTree.getFatAABB(a.treeProxy), dynamicTree.getFatAABB(b.treeProxy))) {
+                it = dynamicTreePairs.erase(it);
+                continue;
+            }
+            if (checkAABBCollision(a.worldBox, b.worldBox)) {
+                candidatePairs.push_back(*it);
+            }
+            ++it;
+        }
+        break;
+    }
+
+    dynamicTreeStats = dynamicTree.getStats();
+    dynamicTree.resetStats();
+}
+
+void Scene::updateNarrowPhase() {
+    collidingPairs.clear();
+
+    // 후보에서 빠진 쌍의 front 와 GJK simplex 는 버린다
+    std::map<std::pair<int, int>, CollisionFront> activeFronts;
+    std::map<std::pair<int, int>, GjkCache> activeCaches;
+    for (const auto& pair : candidatePairs) {
+        auto it = collisionFronts.find(pair);
+        if (it != collisionFronts.end()) {
+            activeFronts[pair] = std::move(it->second);
+        }
+        else {
+            activeFronts[pair];
+        }
+        activeCaches[pair] = gjkCaches[pair];
+    }
+    collisionFronts.swap(activeFronts);
+    gjkCaches.swap(activeCaches);
+
+    for (auto& entry : collisionFronts) {
+        const MeshInstance& a = instances[entry.first.first];
+        const MeshInstance& b = instances[entry.first.second];
+        Mesh& meshA = meshes[a.mesh];
+        Mesh& meshB = meshes[b.mesh];
+        updateHull(meshA);
+        updateHull(meshB);
+        glm::mat4 bToA = glm::inverse(a.transform) * b.transform;
+
+        // 볼록 껍질이 떨어져 있으면 삼각형도 떨어져 있다 (평평한 mesh 는 껍질이 비어 있어 건너뛴다)
+        if (!meshA.hull.vertices.empty() && !meshB.hull.vertices.empty() &&
+            !gjkIntersect(meshA.hull, meshB.hull, bToA, &gjkCaches[entry.first])) {
+            continue;
+        }
+
+        if (entry.second.update(meshA.octree, meshB.octree, bToA)) {
+            collidingPairs.push_back(entry.first);
+        }
+    }
+}
+
+const CollisionFront* Scene::getCollisionFront(int first, int second) const {
+    auto it = collisionFronts.find(std::make_pair(std::min(first, second), std::max(first, second)));
+    return it != collisionFronts.end() ? &it->second : nullptr;
+}
+
+int Scene::pick(const glm::vec3& origin, const glm::vec3& direction, float tMax, RayHit* hit) const {
+    glm::vec3 invDirection = 1.0f / direction;
+    std::vector<std::pair<float, int>> order;
+    for (size_t i = 0; i < instances.size(); ++i) {
+        float tNear;
+        if (intersectRayAABB(origin, invDirection, instances[i].worldBox, tMax, tNear)) {
+            order.emplace_back(tNear, static_cast<int>(i));
+        }
+    }
+    std::sort(order.begin(), order.end());
+
+    // affine 변환이므로 local 광선의 t 가 world 광선의 t 와 같다
+    RayHit best;
+    best.distance = tMax;
+    int picked = -1;
+    for (const auto& entry : order) {
+        if (entry.first > best.distance) break;
+
+        const MeshInstance& instance = instances[entry.second];
+        glm::mat4 worldToLocal = glm::inverse(instance.transform);
+        glm::vec3 localOrigin(worldToLocal * glm::vec4(origin, 1.0f));
+        glm::vec3 localDirection(worldToLocal * glm::vec4(direction, 0.0f));
+        if (raycastFrom(meshes[instance.mesh].octree, localOrigin, localDirection, best)) {
+            picked = entry.second;
+        }
+    }
+
+    if (hit) {
+        *hit = best;
+    }
+    return picked;
+}
+
+bool Scene::computeContact(int first, int second, ContactManifold& manifold) {
+    const MeshInstance& a = instances[first];
+    const MeshInstance& b = instances[second];
+    Mesh& meshA = meshes[a.mesh];
+    Mesh& meshB = meshes[b.mesh];
+    updateHull(meshA);
+    updateHull(meshB);
+    updateDistanceField(meshA);
+    updateDistanceField(meshB);
+
+    glm::mat4 bToA = glm::inverse(a.transform) * b.transform;
+    bool touching = computeContacts(meshA.distanceField, meshA.octree, meshA.welded,
+        &meshB.distanceField, meshB.octree, meshB.welded, bToA, manifold);
+
+    glm::mat3 rotation(a.transform);
+    for (int i = 0; i < manifold.count; ++i) {
+        manifold.points[i].position = glm::vec3(a.transform * glm::vec4(manifold.points[i].position, 1.0f));
+        manifold.points[i].normal = rotation * manifold.points[i].normal;
+    }
+    manifold.normal = rotation * manifold.normal;
+    return touching;
+}
@@ -0,0 +1,99 @@
+﻿#pragma once
+
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+#include <glm/glm/glm.hpp>
+#include "collision.h"
+#include "contact.h"
+#include "distance_field.h"
+#include "dynamic_aabb_tree.h"
+#include "geometry.h"
+#include "gjk.h"
+#include "mesh.h"
+#include "octree.h"
+#include "raycast.h"
+#include "spatial_hash.h"
+#include "sweep_and_prune.h"
+
+struct Mesh {
+    std::vector<Triangle> triangles;
+    AABB box;
+    OctreeNode* octree = nullptr;
+    IndexedMesh welded;
+    IndexedMesh hull;
+    DistanceField distanceField;  // addMesh 에서 만든다
+    // updateMeshTriangles 뒤에는 welded, hull 과 distanceField 가 옛 삼각형 기준이다.
+    // GJK 와 접촉 계산이 처음 쓸 때 다시 만든다
+    bool hullDirty = false;
+    bool distanceFieldDirty = false;
+};
+
+struct MeshInstance {
+    int mesh;
+    glm::mat4 transform;
+    AABB worldBox;
+    int proxy;
+    int treeProxy;
+};
+
+enum class BroadPhaseType {
+    SweepAndPrune,
+    SpatialHash,
+    DynamicTree
+};
+
+// 여러 mesh instance 를 관리하고 broad phase 로 충돌 후보 쌍을 찾은 뒤
+// 쌍마다 CollisionFront 를 유지하며 octree 끼리 narrow phase 를 수행한다.
+// mesh 는 instance 들이 공유하며 octree 도 mesh 당 한 번만 만든다.
+class Scene {
+public:
+    Scene() = default;
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+    ~Scene();
+
+    int addMesh(const std::vector<Triangle>& triangles);
+    // 위상은 그대로이고 꼭짓점만 움직인 삼각형 (morph target 등). octree 는 다시 만들지 않고 refit 하며
+    // 볼록 껍질과 distance field 는 필요할 때까지 미룬다
+    void updateMeshTriangles(int mesh, const std::vector<Triangle>& triangles);
+    int addInstance(int mesh, const glm::mat4& transform);
+    void setTransform(int instance, const glm::mat4& transform);
+    void translateInstance(int instance, const glm::vec3& delta);
+
+    void update();
+    const std::vector<std::pair<int, int>>& getCandidatePairs() const { return candidatePairs; }
+    const std::vector<std::pair<int, int>>& getCollidingPairs() const { return collidingPairs; }
+    const CollisionFront* getCollisionFront(int first, int second) const;
+    const DynamicTreeStats& getDynamicTreeStats() const { return dynamicTreeStats; }
+
+    // world 광선이 처음 맞는 instance, 없으면 -1. world box 로 먼저 거르고 가까운 instance 부터
+    // local 좌표계에서 octree 를 검사한다. hit.distance 는 world 광선의 t
+    int pick(const glm::vec3& origin, const glm::vec3& direction, float tMax, RayHit* hit = nullptr) const;
+
+    // 두 instance 의 접촉점을 world 좌표로. normal 은 first 에서 second 를 밀어낼 방향
+    bool computeContact(int first, int second, ContactManifold& manifold);
+
+    std::vector<Mesh> meshes;
+    std::vector<MeshInstance> instances;
+    BroadPhaseType broadPhase = BroadPhaseType::SweepAndPrune;
+    // refitOctree 의 rebuildThreshold (0 이면 다시 만들지 않는다)
+    float refitRebuildThreshold = 1.5f;
+
+private:
+    void updateBroadPhase();
+    void updateNarrowPhase();
+
+    SweepAndPrune sweepAndPrune;
+    SpatialHashGrid spatialHash;
+    std::vector<AABB> worldBoxes;
+    DynamicAABBTree dynamicTree;
+    std::set<std::pair<int, int>> dynamicTreePairs;
+    DynamicTreeStats dynamicTreeStats;
+    std::vector<int> proxyToInstance;
+    std::vector<std::pair<int, int>> candidatePairs;
+    std::vector<std::pair<int, int>> collidingPairs;
+    std::map<std::pair<int, int>, CollisionFront> collisionFronts;
+    std::map<std::pair<int, int>, GjkCache> gjkCaches;
+};
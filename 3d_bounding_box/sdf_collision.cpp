@@ -0,0 +1,137 @@
+﻿#include "sdf_collision.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "collision.h"
+#include "parallel.h"
+
+namespace {
+
+// 삼각형 하나가 tree 의 삼각형과 교차하는지
+bool collideTriangle(const OctreeNode* node, const glm::vec3 tri[3], const AABB& triBox) {
+    if (!checkAABBCollision(node->bounds, triBox)) {
+        return false;
+    }
+
+    if (node->isLeaf()) {
+        for (const auto& other : node->triangles) {
+            AABB otherBox;
+            otherBox.min = glm::min(glm::min(other.vertices[0], other.vertices[1]), other.vertices[2]);
+            otherBox.max = glm::max(glm::max(other.vertices[0], other.vertices[1]), other.vertices[2]);
+            if (checkAABBCollision(otherBox, triBox) && checkTriangleCollision(other.vertices, tri)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        if (node->children[i] && collideTriangle(node->children[i], tri, triBox)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 꼭짓점에서 이웃 삼각형 안의 가장 먼 점까지 거리의 제곱 (이웃 모서리 길이 제곱의 최댓값)
+void computeVertexReach(const IndexedMesh& mesh, std::vector<float>& reach) {
+    reach.assign(mesh.vertices.size(), 0.0f);
+    for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+        const int* index = &mesh.indices[i];
+        for (int e = 0; e < 3; ++e) {
+            int a = index[e];
+            int b = index[(e + 1) % 3];
+            glm::vec3 d = mesh.vertices[b] - mesh.vertices[a];
+            float lengthSq = glm::dot(d, d);
+            reach[a] = std::max(reach[a], lengthSq);
+            reach[b] = std::max(reach[b], lengthSq);
+        }
+    }
+}
+
+DistanceFieldCollision collide(const DistanceField& fieldA, const OctreeNode* treeA, const IndexedMesh& meshB,
+    const std::vector<float>& vertexReach, const glm::mat4& bToA) {
+    DistanceFieldCollision result;
+    result.minDistance = std::numeric_limits<float>::max();
+    if (!treeA || meshB.vertices.empty()) {
+        return result;
+    }
+
+    // 1-Lipschitz 인 거리 함수를 trilinear 보간한 값은 실제 값과 cell 대각선 이상 차이 나지 않는다.
+    // b 전체를 감싸는 구의 중심 거리가 반지름보다 확실히 크면 꼭짓점을 볼 필요가 없다
+    const float error = std::sqrt(3.0f) * fieldA.getCellSize();
+    glm::vec3 center(bToA * glm::vec4(calculateCenter(meshB.bounds), 1.0f));
+    float radius = 0.5f * glm::length(meshB.bounds.max - meshB.bounds.min);
+    float centerDistance = fieldA.sample(center);
+    if (std::abs(centerDistance) - error > radius) {
+        result.minDistance = std::abs(centerDistance) - radius;
+        return result;
+    }
+
+    // 자세마다 할당하지 않도록 스레드별 버퍼를 재사용한다
+    thread_local std::vector<float> distances;
+    thread_local std::vector<char> separated;
+    distances.resize(meshB.vertices.size());
+    separated.resize(meshB.vertices.size());
+    fieldA.sample(meshB.vertices.data(), meshB.vertices.size(), bToA, distances.data());
+
+    // 꼭짓점의 |거리| 가 이웃 삼각형 전체를 덮으면 그 삼각형들은 a 표면을 지나지 않는다
+    size_t separatedCount = 0;
+    for (size_t i = 0; i < distances.size(); ++i) {
+        result.minDistance = std::min(result.minDistance, distances[i]);
+        float clearance = std::abs(distances[i]) - error;
+        separated[i] = clearance > 0.0f && clearance * clearance > vertexReach[i];
+        separatedCount += separated[i];
+    }
+    if (separatedCount == distances.size()) {
+        return result;
+    }
+
+    size_t triangleCount = meshB.getTriangleCount();
+    for (size_t t = 0; t < triangleCount; ++t) {
+        const int* index = &meshB.indices[t * 3];
+        if (separated[index[0]] || separated[index[1]] || separated[index[2]]) continue;
+
+        ++result.exactTriangles;
+        glm::vec3 tri[3];
+        for (int i = 0; i < 3; ++i) {
+            tri[i] = glm::vec3(bToA * glm::vec4(meshB.vertices[index[i]], 1.0f));
+        }
+        AABB triBox;
+        triBox.min = glm::min(glm::min(tri[0], tri[1]), tri[2]);
+        triBox.max = glm::max(glm::max(tri[0], tri[1]), tri[2]);
+        if (collideTriangle(treeA, tri, triBox)) {
+            result.colliding = true;
+            break;
+        }
+    }
+    return result;
+}
+
+}
+
+DistanceFieldCollision collideDistanceField(const DistanceField& fieldA, const OctreeNode* treeA,
+    const IndexedMesh& meshB, const glm::mat4& bToA) {
+    thread_local std::vector<float> vertexReach;
+    computeVertexReach(meshB, vertexReach);
+    return collide(fieldA, treeA, meshB, vertexReach, bToA);
+}
+
+void collideDistanceFieldBatch(const DistanceField& fieldA, const OctreeNode* treeA, const IndexedMesh& meshB,
+    const glm::mat4* poses, size_t poseCount, std::vector<uint64_t>& results) {
+    results.assign((poseCount + 63) / 64, 0);
+    std::vector<float> vertexReach;
+    computeVertexReach(meshB, vertexReach);
+
+    // grain 을 64 로 맞춰 각 작업이 결과 word 하나를 혼자 쓰게 한다
+    parallelFor(poseCount, 64, [&](size_t begin, size_t end, unsigned) {
+        uint64_t word = 0;
+        for (size_t i = begin; i < end; ++i) {
+            if (collide(fieldA, treeA, meshB, vertexReach, poses[i]).colliding) {
+                word |= 1ull << (i & 63);
+            }
+        }
+        results[begin / 64] = word;
+    });
+}
@@ -0,0 +1,26 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm/glm.hpp>
+#include "distance_field.h"
+#include "mesh.h"
+#include "octree.h"
+
+struct DistanceFieldCollision {
+    bool colliding = false;
+    float minDistance = 0.0f;   // b 꼭짓점의 보간 거리 중 최솟값. 음수면 그 깊이만큼 a 안에 들어간 꼭짓점이 있다
+    size_t exactTriangles = 0;  // 정확한 삼각형 검사로 넘어간 b 삼각형 수
+};
+
+// 고정된 a 의 distance field 에 b 꼭짓점(bToA 로 옮긴 것)을 찍어 충돌을 판단한다.
+// 꼭짓점의 |거리| 가 이웃 모서리 길이보다 확실히 크면 이웃 삼각형 전체가 a 표면의 한쪽에 있으므로
+// 건너뛰고, 나머지 삼각형만 treeA 와 정확히 검사한다. bToA 는 길이를 보존하는 강체 변환이어야 하며
+// 결과는 collideOctrees(treeA, treeB, bToA) 와 같다
+DistanceFieldCollision collideDistanceField(const DistanceField& fieldA, const OctreeNode* treeA,
+    const IndexedMesh& meshB, const glm::mat4& bToA);
+
+// 여러 자세를 스레드에 나눠 검사한다. 결과는 pose i 가 bit (i % 64) of results[i / 64]
+void collideDistanceFieldBatch(const DistanceField& fieldA, const OctreeNode* treeA, const IndexedMesh& meshB,
+    const glm::mat4* poses, size_t poseCount, std::vector<uint64_t>& results);
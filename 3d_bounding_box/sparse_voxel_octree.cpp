@@ -0,0 +1,349 @@
+﻿#include "sparse_voxel_octree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include "aabb_simd.h"
+#include "parallel.h"
+
+const int SparseVoxelOctree::maxLevels;
+
+namespace {
+
+// 21 bit 정수의 bit 사이에 0 을 두 개씩 끼운다
+uint64_t expandBits(uint32_t value) {
+    uint64_t x = value & 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffull;
+    x = (x | x << 16) & 0x1f0000ff0000ffull;
+    x = (x | x << 8) & 0x100f00f00f00f00full;
+    x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+    x = (x | x << 2) & 0x1249249249249249ull;
+    return x;
+}
+
+// splitAABB 의 자식 번호와 같게 x 가 가장 낮은 bit
+uint64_t mortonCode(const glm::ivec3& coord) {
+    return expandBits(coord.x) | (expandBits(coord.y) << 1) | (expandBits(coord.z) << 2);
+}
+
+glm::ivec3 childCoord(const glm::ivec3& coord, int child) {
+    return coord * 2 + glm::ivec3(child & 1, (child >> 1) & 1, (child >> 2) & 1);
+}
+
+void collectLeaves(const OctreeNode* node, std::vector<const OctreeNode*>& leaves) {
+    if (node->isLeaf()) {
+        leaves.push_back(node);
+        return;
+    }
+    for (int i = 0; i < 8; ++i) {
+        if (node->children[i]) {
+            collectLeaves(node->children[i], leaves);
+        }
+    }
+}
+
+// 분리 축 13개와 그 축에 대한 삼각형 투영 범위를 미리 계산해 두고 cell 마다 중심의 투영만 구한다
+struct TriangleAxes {
+    glm::vec3 axes[13];
+    glm::vec3 absAxes[13];
+    float min[13];
+    float max[13];
+
+    explicit TriangleAxes(const glm::vec3 v[3]) {
+        glm::vec3 edges[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+        int count = 0;
+        for (int i = 0; i < 3; ++i) {
+            glm::vec3 unit(0.0f);
+            unit[i] = 1.0f;
+            axes[count++] = unit;
+            for (int j = 0; j < 3; ++j) {
+                axes[count++] = glm::cross(unit, edges[j]);
+            }
+        }
+        axes[count] = glm::cross(edges[0], edges[1]);
+
+        for (int k = 0; k < 13; ++k) {
+            absAxes[k] = glm::abs(axes[k]);
+            float p0 = glm::dot(v[0], axes[k]);
+            float p1 = glm::dot(v[1], axes[k]);
+            float p2 = glm::dot(v[2], axes[k]);
+            min[k] = glm::min(glm::min(p0, p1), p2);
+            max[k] = glm::max(glm::max(p0, p1), p2);
+        }
+    }
+
+    bool overlaps(const glm::vec3& center, const glm::vec3& half) const {
+        for (int k = 0; k < 13; ++k) {
+            float c = glm::dot(center, axes[k]);
+            float r = glm::dot(half, absAxes[k]);
+            if (min[k] - c > r || max[k] - c < -r) return false;
+        }
+        return true;
+    }
+};
+
+struct TriangleVoxelizer {
+    glm::vec3 origin;
+    glm::vec3 extent;
+    int depth;
+    std::vector<uint64_t>* codes;
+
+    void run(const TriangleAxes& triangle, int level, const glm::ivec3& coord) const {
+        glm::vec3 half = extent / static_cast<float>(2u << level);
+        glm::vec3 center = origin + (glm::vec3(coord) * 2.0f + 1.0f) * half;
+        if (!triangle.overlaps(center, half)) return;
+        if (level == depth) {
+            codes->push_back(mortonCode(coord));
+            return;
+        }
+        for (int child = 0; child < 8; ++child) {
+            run(triangle, level + 1, childCoord(coord, child));
+        }
+    }
+
+    // 삼각형 box 가 축마다 cell 두 개 안에 드는 가장 깊은 level 에서 시작한다
+    void operator()(const glm::vec3 v[3]) const {
+        glm::vec3 lo = glm::min(glm::min(v[0], v[1]), v[2]);
+        glm::vec3 hi = glm::max(glm::max(v[0], v[1]), v[2]);
+        int level = depth;
+        for (int i = 0; i < 3; ++i) {
+            float size = hi[i] - lo[i];
+            if (size > 0.0f) {
+                int fit = static_cast<int>(std::floor(std::log2(extent[i] / size)));
+                level = std::min(level, std::max(fit, 0));
+            }
+        }
+
+        glm::vec3 cellSize = extent / static_cast<float>(1u << level);
+        glm::ivec3 last((1 << level) - 1);
+        glm::ivec3 first = glm::clamp(glm::ivec3(glm::floor((lo - origin) / cellSize)), glm::ivec3(0), last);
+        glm::ivec3 end = glm::clamp(glm::ivec3(glm::floor((hi - origin) / cellSize)), glm::ivec3(0), last);
+        TriangleAxes triangle(v);
+        glm::ivec3 coord;
+        for (coord.z = first.z; coord.z <= end.z; ++coord.z) {
+            for (coord.y = first.y; coord.y <= end.y; ++coord.y) {
+                for (coord.x = first.x; coord.x <= end.x; ++coord.x) {
+                    run(triangle, level, coord);
+                }
+            }
+        }
+    }
+};
+
+}
+
+void SparseVoxelOctree::build(const OctreeNode* tree, int depth) {
+    levels.clear();
+    voxelCount = 0;
+    if (!tree) return;
+    bounds = tree->box;
+    depth = glm::clamp(depth, 1, maxLevels);
+
+    // 삼각형은 leaf cell 밖으로 나갈 수 있으므로 cell 로 자르지 않고 삼각형 전체를 voxel 로 나눈다.
+    // 여러 leaf 에 복사된 삼각형은 처음 나온 leaf 에서만 처리한다
+    std::vector<const OctreeNode*> leaves;
+    collectLeaves(tree, leaves);
+
+    std::vector<int> owners;
+    for (size_t i = 0; i < leaves.size(); ++i) {
+        for (int id : leaves[i]->triangleIds) {
+            if (id >= static_cast<int>(owners.size())) {
+                owners.resize(id + 1, -1);
+            }
+            if (owners[id] < 0) {
+                owners[id] = static_cast<int>(i);
+            }
+        }
+    }
+
+    std::vector<std::vector<uint64_t>> workerCodes(getWorkerCount());
+    parallelFor(leaves.size(), 1, [&](size_t begin, size_t end, unsigned worker) {
+        TriangleVoxelizer voxelizer = { bounds.min, bounds.max - bounds.min, depth, &workerCodes[worker] };
+        for (size_t i = begin; i < end; ++i) {
+            const OctreeNode* leaf = leaves[i];
+            for (size_t t = 0; t < leaf->triangles.size(); ++t) {
+                if (owners[leaf->triangleIds[t]] == static_cast<int>(i)) {
+                    voxelizer(leaf->triangles[t].vertices);
+                }
+            }
+        }
+    });
+
+    std::vector<uint64_t> codes;
+    for (auto& worker : workerCodes) {
+        codes.insert(codes.end(), worker.begin(), worker.end());
+        std::vector<uint64_t>().swap(worker);
+    }
+    std::sort(codes.begin(), codes.end());
+    codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+    if (codes.empty()) return;
+    voxelCount = codes.size();
+
+    // 정렬된 code 를 3 bit 씩 줄이면 부모 level 의 노드가 Morton 순서로 나온다
+    levels.resize(depth);
+    for (int level = depth - 1; level >= 0; --level) {
+        Level& current = levels[level];
+        size_t parents = 0;
+        for (uint64_t code : codes) {
+            uint64_t parent = code >> 3;
+            if (parents == 0 || codes[parents - 1] != parent) {
+                codes[parents++] = parent;
+                current.masks.push_back(0);
+            }
+            current.masks.back() |= static_cast<uint8_t>(1u << (code & 7));
+        }
+        codes.resize(parents);
+
+        current.masks.resize((current.masks.size() + 7) & ~size_t(7), 0);
+        current.ranks.resize(current.masks.size() / 8);
+        uint32_t rank = 0;
+        for (size_t block = 0; block < current.ranks.size(); ++block) {
+            current.ranks[block] = rank;
+            uint64_t word;
+            std::memcpy(&word, &current.masks[block * 8], sizeof(word));
+            rank += countBits(word);
+        }
+    }
+}
+
+uint32_t SparseVoxelOctree::childIndex(int level, uint32_t index, int child) const {
+    const Level& current = levels[level];
+    uint32_t block = index >> 3;
+    uint64_t word;
+    std::memcpy(&word, &current.masks[block * 8], sizeof(word));
+    uint64_t before = (1ull << ((index & 7) * 8)) - 1;
+    uint8_t mask = current.masks[index];
+    return current.ranks[block] + countBits(word & before) + countBits(mask & ((1u << child) - 1));
+}
+
+AABB SparseVoxelOctree::cellBox(int level, const glm::ivec3& coord) const {
+    glm::vec3 size = getCellSize(level);
+    AABB box;
+    box.min = bounds.min + glm::vec3(coord) * size;
+    box.max = box.min + size;
+    return box;
+}
+
+bool SparseVoxelOctree::isOccupied(const glm::vec3& point) const {
+    if (levels.empty()) return false;
+
+    int depth = getDepth();
+    glm::ivec3 coord = glm::ivec3(glm::floor((point - bounds.min) / getCellSize(depth)));
+    if (glm::any(glm::lessThan(coord, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(coord, glm::ivec3(1 << depth)))) {
+        return false;
+    }
+
+    uint32_t index = 0;
+    for (int level = 0; level < depth; ++level) {
+        int shift = depth - 1 - level;
+        int child = ((coord.x >> shift) & 1) | (((coord.y >> shift) & 1) << 1) | (((coord.z >> shift) & 1) << 2);
+        if (!(levels[level].masks[index] & (1u << child))) return false;
+        if (level + 1 < depth) {
+            index = childIndex(level, index, child);
+        }
+    }
+    return true;
+}
+
+bool SparseVoxelOctree::overlaps(const AABB& box) const {
+    if (levels.empty()) return false;
+
+    int depth = getDepth();
+    std::vector<Cell> stack;
+    stack.push_back({ 0, 0, glm::ivec3(0) });
+    while (!stack.empty()) {
+        Cell cell = stack.back();
+        stack.pop_back();
+        if (!checkAABBCollision(cellBox(cell.level, cell.coord), box)) continue;
+        if (cell.level == depth) return true;
+
+        uint8_t mask = levels[cell.level].masks[cell.index];
+        uint32_t first = cell.level + 1 < depth ? childIndex(cell.level, cell.index, 0) : 0;
+        for (int child = 0, k = 0; child < 8; ++child) {
+            if (!(mask & (1u << child))) continue;
+            stack.push_back({ cell.level + 1, first + k++, childCoord(cell.coord, child) });
+        }
+    }
+    return false;
+}
+
+bool SparseVoxelOctree::overlaps(const SparseVoxelOctree& other, const glm::mat4& otherToThis) const {
+    if (levels.empty() || other.levels.empty()) return false;
+
+    int depthA = getDepth();
+    int depthB = other.getDepth();
+    std::vector<std::pair<Cell, Cell>> stack;
+    stack.push_back({ { 0, 0, glm::ivec3(0) }, { 0, 0, glm::ivec3(0) } });
+    while (!stack.empty()) {
+        Cell a = stack.back().first;
+        Cell b = stack.back().second;
+        stack.pop_back();
+
+        AABB boxA = cellBox(a.level, a.coord);
+        AABB boxB = transformAABB(other.cellBox(b.level, b.coord), otherToThis);
+        if (!checkAABBCollision(boxA, boxB)) continue;
+
+        bool leafA = a.level == depthA;
+        bool leafB = b.level == depthB;
+        if (leafA && leafB) return true;
+
+        // voxel 이 아니면서 더 큰 쪽을 나눈다
+        glm::vec3 sizeA = boxA.max - boxA.min;
+        glm::vec3 sizeB = boxB.max - boxB.min;
+        bool splitA = leafB || (!leafA && glm::dot(sizeA, sizeA) >= glm::dot(sizeB, sizeB));
+        const SparseVoxelOctree& tree = splitA ? *this : other;
+        const Cell& cell = splitA ? a : b;
+
+        uint8_t mask = tree.levels[cell.level].masks[cell.index];
+        uint32_t first = cell.level + 1 < tree.getDepth() ? tree.childIndex(cell.level, cell.index, 0) : 0;
+        for (int child = 0, k = 0; child < 8; ++child) {
+            if (!(mask & (1u << child))) continue;
+            Cell next = { cell.level + 1, first + k++, childCoord(cell.coord, child) };
+            stack.push_back(splitA ? std::make_pair(next, b) : std::make_pair(a, next));
+        }
+    }
+    return false;
+}
+
+void SparseVoxelOctree::collectCells(int level, std::vector<AABB>& cells) const {
+    cells.clear();
+    int depth = getDepth();
+    if (levels.empty() || level < 0 || level > depth) return;
+
+    std::vector<Cell> stack;
+    stack.push_back({ 0, 0, glm::ivec3(0) });
+    while (!stack.empty()) {
+        Cell cell = stack.back();
+        stack.pop_back();
+        if (cell.level == level) {
+            cells.push_back(cellBox(cell.level, cell.coord));
+            continue;
+        }
+
+        uint8_t mask = levels[cell.level].masks[cell.index];
+        uint32_t first = cell.level + 1 < depth ? childIndex(cell.level, cell.index, 0) : 0;
+        for (int child = 0, k = 0; child < 8; ++child) {
+            if (!(mask & (1u << child))) continue;
+            stack.push_back({ cell.level + 1, first + k++, childCoord(cell.coord, child) });
+        }
+    }
+}
+
+size_t SparseVoxelOctree::getNodeCount() const {
+    size_t count = 0;
+    for (const auto& level : levels) {
+        for (uint8_t mask : level.masks) {
+            count += mask != 0;
+        }
+    }
+    return count;
+}
+
+size_t SparseVoxelOctree::getMemoryUsage() const {
+    size_t bytes = 0;
+    for (const auto& level : levels) {
+        bytes += level.masks.size() * sizeof(uint8_t) + level.ranks.size() * sizeof(uint32_t);
+    }
+    return bytes;
+}
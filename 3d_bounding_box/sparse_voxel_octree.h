@@ -0,0 +1,55 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm/glm.hpp>
+#include "geometry.h"
+#include "octree.h"
+
+// 표면이 지나는 voxel 만 담는 sparse voxel octree. root 와 자식 번호가 octree 와 같아서
+// 위쪽 level 의 cell 은 octree 의 cell 과 일치한다. 노드는 자식 8개의 점유 여부를 담은 8 bit mask 하나이고
+// level 별로 Morton 순서로 나열하므로 포인터가 없다. 자식 위치는 같은 level 에서 앞선 mask 의 1 bit 수로 구하며
+// 8 노드마다 그 누적값을 저장한다 (노드당 1.5 byte). 마지막 level 의 mask bit 가 voxel 이다
+class SparseVoxelOctree {
+public:
+    static const int maxLevels = 21;
+
+    // tree 의 leaf 를 스레드에 나눠 각 leaf 삼각형이 닿는 depth level voxel 을 모은다.
+    // voxel 크기는 tree->box 를 축마다 2^depth 로 나눈 크기
+    void build(const OctreeNode* tree, int depth);
+
+    bool isOccupied(const glm::vec3& point) const;
+    bool overlaps(const AABB& box) const;
+    // other 를 otherToThis 로 옮겨 점유 cell 끼리 box 가 겹치는지 (회전하면 voxel 의 AABB 로 보수적으로 판단)
+    bool overlaps(const SparseVoxelOctree& other, const glm::mat4& otherToThis) const;
+
+    // level 의 점유 cell box (level == depth 이면 voxel). 시각화용
+    void collectCells(int level, std::vector<AABB>& cells) const;
+
+    int getDepth() const { return static_cast<int>(levels.size()); }
+    const AABB& getBounds() const { return bounds; }
+    glm::vec3 getCellSize(int level) const { return (bounds.max - bounds.min) / static_cast<float>(1u << level); }
+    size_t getNodeCount() const;
+    size_t getVoxelCount() const { return voxelCount; }
+    size_t getMemoryUsage() const;
+
+private:
+    struct Level {
+        std::vector<uint8_t> masks;   // 8의 배수 길이 (남는 칸은 0)
+        std::vector<uint32_t> ranks;  // masks[8k] 앞까지 1 bit 수
+    };
+
+    struct Cell {
+        int level;
+        uint32_t index;  // level == depth 이면 쓰지 않는다
+        glm::ivec3 coord;
+    };
+
+    uint32_t childIndex(int level, uint32_t index, int child) const;
+    AABB cellBox(int level, const glm::ivec3& coord) const;
+
+    AABB bounds;
+    std::vector<Level> levels;
+    size_t voxelCount = 0;
+};
@@ -0,0 +1,217 @@
+﻿#include "spatial_hash.h"
+
+#include <algorithm>
+#include <cmath>
+#include "aabb_simd.h"
+#include "parallel.h"
+
+const uint64_t SpatialHashGrid::emptyKey;
+const size_t SpatialHashGrid::maxCellsPerBox;
+
+// 삽입과 쌍 보고가 같은 cell 을 보도록 cell 좌표는 항상 이 double 계산으로 구한다
+glm::dvec3 SpatialHashGrid::cellCoord(const glm::vec3& p) const {
+    return glm::floor(glm::dvec3(p) / static_cast<double>(cellSize));
+}
+
+glm::ivec3 SpatialHashGrid::cellOf(const glm::vec3& p) const {
+    return glm::ivec3(cellCoord(p));
+}
+
+uint64_t SpatialHashGrid::packCell(const glm::ivec3& cell) {
+    // 축마다 아래 21 bit. 2^21 cell 떨어진 cell 은 같은 key 가 되지만 한 box 는 maxCellsPerBox 개까지만
+    // 걸치므로 같은 cell 리스트에 두 번 들어가지 않고, 다른 box 는 겹침 검사로 걸러진다
+    const uint64_t mask = (1u << 21) - 1;
+    uint64_t x = static_cast<uint64_t>(static_cast<uint32_t>(cell.x)) & mask;
+    uint64_t y = static_cast<uint64_t>(static_cast<uint32_t>(cell.y)) & mask;
+    uint64_t z = static_cast<uint64_t>(static_cast<uint32_t>(cell.z)) & mask;
+    return x | (y << 21) | (z << 42);
+}
+
+uint64_t SpatialHashGrid::hashKey(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return key;
+}
+
+SpatialHashGrid::Slot& SpatialHashGrid::findOrInsert(uint64_t key, std::atomic<size_t>& occupied) {
+    size_t index = static_cast<size_t>(hashKey(key)) & slotMask;
+    for (;;) {
+        Slot& slot = slots[index];
+        uint64_t current = slot.key.load(std::memory_order_acquire);
+        if (current == key) return slot;
+        if (current == emptyKey) {
+            if (slot.key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+                occupied.fetch_add(1, std::memory_order_relaxed);
+                return slot;
+            }
+            if (current == key) return slot;
+        }
+        index = (index + 1) & slotMask;
+    }
+}
+
+void SpatialHashGrid::build(const std::vector<AABB>& inputBoxes, float size) {
+    boxes = inputBoxes;
+
+    if (size <= 0.0f) {
+        // 평균은 바닥 같은 큰 box 하나에 끌려가므로 중앙값을 쓴다
+        std::vector<float> extents(boxes.size());
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            glm::vec3 extent = boxes[i].max - boxes[i].min;
+            extents[i] = std::max(extent.x, std::max(extent.y, extent.z));
+        }
+        size = 1.0f;
+        if (!extents.empty()) {
+            std::nth_element(extents.begin(), extents.begin() + extents.size() / 2, extents.end());
+            size = extents[extents.size() / 2];
+        }
+        if (!(size > 0.0f)) size = 1.0f;
+    }
+    cellSize = size;
+
+    // 1단계: box 마다 걸치는 cell 범위와 수를 구해 entry 위치를 미리 정한다. 범위는 저장해 두고
+    // 2단계에서 그대로 쓴다 (다시 계산하면 반올림이 달라 정한 칸을 넘칠 수 있다).
+    // cell 수는 int 좌표로 바꾸기 전에 double 로 세어 큰 box 에서 넘치지 않게 한다
+    std::vector<size_t> offsets(boxes.size() + 1, 0);
+    std::vector<uint8_t> large(boxes.size(), 0);
+    std::vector<glm::ivec3> cellMin(boxes.size()), cellMax(boxes.size());
+    parallelFor(boxes.size(), 256, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; ++i) {
+            glm::dvec3 lo = cellCoord(boxes[i].min);
+            glm::dvec3 hi = cellCoord(boxes[i].max);
+            glm::dvec3 count = hi - lo + 1.0;
+            double cells = count.x * count.y * count.z;
+            // int cell 좌표로 나타낼 수 없을 만큼 먼 box 도 따로 둔다
+            glm::dvec3 far = glm::max(glm::abs(lo), glm::abs(hi));
+            if (!(cells <= static_cast<double>(maxCellsPerBox)) || !(std::max(far.x, std::max(far.y, far.z)) < 1e9)) {
+                large[i] = 1;
+                continue;
+            }
+            cellMin[i] = glm::ivec3(lo);
+            cellMax[i] = glm::ivec3(hi);
+            offsets[i + 1] = static_cast<size_t>(cells);
+        }
+    });
+    largeBoxes.clear();
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        offsets[i + 1] += offsets[i];
+        if (large[i]) largeBoxes.push_back(static_cast<int>(i));
+    }
+
+    size_t entryCount = offsets[boxes.size()];
+    entries.resize(entryCount);
+
+    size_t required = 16;
+    while (required < entryCount * 2) required <<= 1;
+    if (required > capacity) {
+        slots.reset(new Slot[required]);
+        capacity = required;
+    }
+    slotMask = capacity - 1;
+
+    parallelFor(capacity, 4096, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; ++i) {
+            slots[i].key.store(emptyKey, std::memory_order_relaxed);
+            slots[i].head.store(-1, std::memory_order_relaxed);
+        }
+    });
+
+    // 2단계: cell slot 을 CAS 로 확보하고 entry 를 cell 리스트 앞에 붙인다
+    std::atomic<size_t> occupied(0);
+    parallelFor(boxes.size(), 64, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; ++i) {
+            if (large[i]) continue;
+            const glm::ivec3& lo = cellMin[i];
+            const glm::ivec3& hi = cellMax[i];
+            int entryIndex = static_cast<int>(offsets[i]);
+
+            for (int z = lo.z; z <= hi.z; ++z) {
+                for (int y = lo.y; y <= hi.y; ++y) {
+                    for (int x = lo.x; x <= hi.x; ++x) {
+                        Slot& slot = findOrInsert(packCell(glm::ivec3(x, y, z)), occupied);
+                        entries[entryIndex].box = static_cast<int>(i);
+                        entries[entryIndex].next = slot.head.exchange(entryIndex, std::memory_order_acq_rel);
+                        ++entryIndex;
+                    }
+                }
+            }
+        }
+    });
+    occupiedCells = occupied.load();
+}
+
+void SpatialHashGrid::getPairs(std::vector<std::pair<int, int>>& pairs) const {
+    pairs.clear();
+    if (!slots) return;
+
+    std::vector<std::vector<std::pair<int, int>>> workerPairs(getWorkerCount());
+    parallelFor(capacity, 1024, [&](size_t begin, size_t end, unsigned worker) {
+        std::vector<int> cellBoxes;
+        AABBArray cellArray;
+        std::vector<uint64_t> mask;
+        auto& out = workerPairs[worker];
+
+        for (size_t s = begin; s < end; ++s) {
+            uint64_t key = slots[s].key.load(std::memory_order_relaxed);
+            if (key == emptyKey) continue;
+
+            cellBoxes.clear();
+            for (int e = slots[s].head.load(std::memory_order_relaxed); e >= 0; e = entries[e].next) {
+                cellBoxes.push_back(entries[e].box);
+            }
+            if (cellBoxes.size() < 2) continue;
+
+            cellArray.resize(cellBoxes.size());
+            for (size_t i = 0; i < cellBoxes.size(); ++i) {
+                cellArray.set(i, boxes[cellBoxes[i]]);
+            }
+
+            for (size_t i = 0; i + 1 < cellBoxes.size(); ++i) {
+                const AABB& a = boxes[cellBoxes[i]];
+                overlapMask(a, cellArray, mask);
+
+                for (size_t j = i + 1; j < cellBoxes.size(); ++j) {
+                    if (!testMaskBit(mask, j)) continue;
+                    const AABB& b = boxes[cellBoxes[j]];
+
+                    // 겹치는 영역의 min corner 가 속한 cell 에서만 보고해 중복 제거
+                    if (packCell(cellOf(glm::max(a.min, b.min))) != key) continue;
+
+                    int first = std::min(cellBoxes[i], cellBoxes[j]);
+                    int second = std::max(cellBoxes[i], cellBoxes[j]);
+                    out.emplace_back(first, second);
+                }
+            }
+        }
+    });
+
+    for (const auto& out : workerPairs) {
+        pairs.insert(pairs.end(), out.begin(), out.end());
+    }
+
+    // 큰 box 는 모든 box 와 비교한다. 큰 box 끼리는 번호가 큰 쪽에서만 보고한다
+    if (!largeBoxes.empty()) {
+        AABBArray allBoxes;
+        allBoxes.resize(boxes.size());
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            allBoxes.set(i, boxes[i]);
+        }
+        std::vector<uint8_t> isLarge(boxes.size(), 0);
+        for (int l : largeBoxes) isLarge[l] = 1;
+
+        std::vector<uint64_t> mask;
+        for (int l : largeBoxes) {
+            overlapMask(boxes[l], allBoxes, mask);
+            for (size_t j = 0; j < boxes.size(); ++j) {
+                if (!testMaskBit(mask, j)) continue;
+                int other = static_cast<int>(j);
+                if (isLarge[j] && other <= l) continue;
+                pairs.emplace_back(std::min(l, other), std::max(l, other));
+            }
+        }
+    }
+    std::sort(pairs.begin(), pairs.end());
+}
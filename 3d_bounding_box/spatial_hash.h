@@ -0,0 +1,53 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "geometry.h"
+
+// 균일 격자를 cell 좌표 해시로 관리하는 broad phase.
+// 매 프레임 build() 로 다시 만들며, 삽입은 CAS 기반이라 스레드 간 잠금이 없다.
+// 크기가 비슷한 물체가 많을 때 트리 기반 broad phase 보다 빠르다.
+// maxCellsPerBox 보다 많은 cell 에 걸치는 큰 box (바닥 등) 는 격자에 넣지 않고 모든 box 와 따로 비교한다.
+class SpatialHashGrid {
+public:
+    // cellSize <= 0 이면 box 크기의 중앙값으로 자동 결정
+    void build(const std::vector<AABB>& boxes, float cellSize = 0.0f);
+    void getPairs(std::vector<std::pair<int, int>>& pairs) const;
+
+    float getCellSize() const { return cellSize; }
+    size_t getOccupiedCellCount() const { return occupiedCells; }
+    size_t getLargeBoxCount() const { return largeBoxes.size(); }
+
+    static const size_t maxCellsPerBox = 64;
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> key;
+        std::atomic<int> head;
+    };
+
+    struct Entry {
+        int box;
+        int next;
+    };
+
+    static const uint64_t emptyKey = ~0ull;
+
+    glm::dvec3 cellCoord(const glm::vec3& p) const;
+    glm::ivec3 cellOf(const glm::vec3& p) const;
+    static uint64_t packCell(const glm::ivec3& cell);
+    static uint64_t hashKey(uint64_t key);
+    Slot& findOrInsert(uint64_t key, std::atomic<size_t>& occupied);
+
+    std::vector<AABB> boxes;
+    float cellSize = 1.0f;
+    std::unique_ptr<Slot[]> slots;
+    size_t slotMask = 0;
+    size_t capacity = 0;
+    std::vector<Entry> entries;
+    std::vector<int> largeBoxes;
+    size_t occupiedCells = 0;
+};
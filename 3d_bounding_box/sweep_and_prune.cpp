@@ -0,0 +1,156 @@
+﻿#include "sweep_and_prune.h"
+
+#include <algorithm>
+#include "aabb_simd.h"
+
+uint64_t SweepAndPrune::pairKey(int a, int b) {
+    if (a > b) std::swap(a, b);
+    return (static_cast<uint64_t>(a) << 32) | static_cast<uint32_t>(b);
+}
+
+bool SweepAndPrune::lessThan(const Endpoint& a, const Endpoint& b) {
+    // 값이 같으면 min 을 앞에 두어 맞닿은 박스도 겹침으로 처리 (checkAABBCollision 과 동일)
+    if (a.value != b.value) return a.value < b.value;
+    return !a.isMax() && b.isMax();
+}
+
+int SweepAndPrune::addBox(const AABB& box) {
+    int id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    }
+    else {
+        id = static_cast<int>(boxes.size());
+        boxes.emplace_back();
+    }
+
+    boxes[id].box = box;
+    boxes[id].alive = true;
+
+    for (int axis = 0; axis < 3; ++axis) {
+        axes[axis].push_back({ box.min[axis], static_cast<uint32_t>(id) << 1 });
+        axes[axis].push_back({ box.max[axis], (static_cast<uint32_t>(id) << 1) | 1 });
+    }
+    ++pendingAdds;
+    return id;
+}
+
+void SweepAndPrune::removeBox(int id) {
+    if (id < 0 || id >= static_cast<int>(boxes.size()) || !boxes[id].alive) return;
+
+    for (int axis = 0; axis < 3; ++axis) {
+        auto& endpoints = axes[axis];
+        endpoints.erase(std::remove_if(endpoints.begin(), endpoints.end(),
+            [id](const Endpoint& e) { return e.boxId() == id; }), endpoints.end());
+    }
+
+    for (auto it = overlapPairs.begin(); it != overlapPairs.end();) {
+        int a = static_cast<int>(*it >> 32);
+        int b = static_cast<int>(*it & 0xffffffffu);
+        if (a == id || b == id) {
+            it = overlapPairs.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    boxes[id].alive = false;
+    freeIds.push_back(id);
+}
+
+void SweepAndPrune::updateBox(int id, const AABB& box) {
+    boxes[id].box = box;
+}
+
+void SweepAndPrune::update() {
+    for (int axis = 0; axis < 3; ++axis) {
+        for (auto& e : axes[axis]) {
+            const AABB& box = boxes[e.boxId()].box;
+            e.value = e.isMax() ? box.max[axis] : box.min[axis];
+        }
+    }
+
+    // 한꺼번에 많이 추가된 경우 insertion sort 대신 전체 정렬 후 다시 sweep
+    size_t liveCount = boxes.size() - freeIds.size();
+    if (pendingAdds * 4 > liveCount) {
+        rebuild();
+    }
+    else {
+        for (int axis = 0; axis < 3; ++axis) {
+            sortAxis(axis);
+        }
+    }
+    pendingAdds = 0;
+}
+
+void SweepAndPrune::rebuild() {
+    for (int axis = 0; axis < 3; ++axis) {
+        std::sort(axes[axis].begin(), axes[axis].end(), lessThan);
+    }
+
+    overlapPairs.clear();
+    std::vector<int> active;
+    AABBArray activeBoxes;
+    std::vector<uint64_t> mask;
+    for (const auto& e : axes[0]) {
+        int id = e.boxId();
+        if (e.isMax()) {
+            size_t index = std::find(active.begin(), active.end(), id) - active.begin();
+            active[index] = active.back();
+            active.pop_back();
+            activeBoxes.swapRemove(index);
+        }
+        else {
+            overlapMask(boxes[id].box, activeBoxes, mask);
+            for (size_t i = 0; i < active.size(); ++i) {
+                if (testMaskBit(mask, i)) {
+                    overlapPairs.insert(pairKey(id, active[i]));
+                }
+            }
+            active.push_back(id);
+            activeBoxes.push(boxes[id].box);
+        }
+    }
+}
+
+void SweepAndPrune::sortAxis(int axis) {
+    auto& endpoints = axes[axis];
+    for (size_t i = 1; i < endpoints.size(); ++i) {
+        Endpoint moving = endpoints[i];
+        size_t j = i;
+        while (j > 0 && lessThan(moving, endpoints[j - 1])) {
+            onSwap(moving, endpoints[j - 1]);
+            endpoints[j] = endpoints[j - 1];
+            --j;
+        }
+        endpoints[j] = moving;
+    }
+}
+
+void SweepAndPrune::onSwap(const Endpoint& moving, const Endpoint& other) {
+    int a = moving.boxId();
+    int b = other.boxId();
+    if (a == b) return;
+
+    if (!moving.isMax() && other.isMax()) {
+        // min 이 다른 박스의 max 왼쪽으로: 이 축에서 겹치기 시작
+        if (checkAABBCollision(boxes[a].box, boxes[b].box)) {
+            overlapPairs.insert(pairKey(a, b));
+        }
+    }
+    else if (moving.isMax() && !other.isMax()) {
+        // max 가 다른 박스의 min 왼쪽으로: 이 축에서 분리
+        overlapPairs.erase(pairKey(a, b));
+    }
+}
+
+void SweepAndPrune::getPairs(std::vector<std::pair<int, int>>& pairs) const {
+    pairs.clear();
+    pairs.reserve(overlapPairs.size());
+    for (uint64_t key : overlapPairs) {
+        pairs.emplace_back(static_cast<int>(key >> 32), static_cast<int>(key & 0xffffffffu));
+    }
+    std::sort(pairs.begin(), pairs.end());
+}
@@ -0,0 +1,49 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "geometry.h"
+
+// 축별 정렬된 끝점 리스트를 유지하는 incremental sweep-and-prune.
+// update() 는 이전 프레임의 정렬 순서에서 insertion sort 로 시작하므로
+// 물체가 조금씩 움직이는 경우 O(n + 교환 횟수) 로 끝난다.
+class SweepAndPrune {
+public:
+    int addBox(const AABB& box);
+    void removeBox(int id);
+    void updateBox(int id, const AABB& box);
+    void update();
+
+    const AABB& getBox(int id) const { return boxes[id].box; }
+    void getPairs(std::vector<std::pair<int, int>>& pairs) const;
+    size_t getPairCount() const { return overlapPairs.size(); }
+
+private:
+    struct Endpoint {
+        float value;
+        uint32_t data;  // (box id << 1) | isMax
+
+        int boxId() const { return static_cast<int>(data >> 1); }
+        bool isMax() const { return (data & 1) != 0; }
+    };
+
+    struct Proxy {
+        AABB box;
+        bool alive = false;
+    };
+
+    static uint64_t pairKey(int a, int b);
+    static bool lessThan(const Endpoint& a, const Endpoint& b);
+
+    void rebuild();
+    void sortAxis(int axis);
+    void onSwap(const Endpoint& moving, const Endpoint& other);
+
+    std::vector<Proxy> boxes;
+    std::vector<int> freeIds;
+    std::vector<Endpoint> axes[3];
+    std::unordered_set<uint64_t> overlapPairs;
+    size_t pendingAdds = 0;
+};
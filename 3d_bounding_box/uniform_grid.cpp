@@ -0,0 +1,214 @@
+﻿#include "uniform_grid.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include "parallel.h"
+
+namespace {
+
+AABB triangleBounds(const Triangle& triangle) {
+    AABB box;
+    box.min = glm::min(glm::min(triangle.vertices[0], triangle.vertices[1]), triangle.vertices[2]);
+    box.max = glm::max(glm::max(triangle.vertices[0], triangle.vertices[1]), triangle.vertices[2]);
+    return box;
+}
+
+}
+
+glm::ivec3 UniformGrid::cellOf(const glm::vec3& p) const {
+    glm::ivec3 cell(glm::floor((p - bounds.min) * invCellSize));
+    return glm::clamp(cell, glm::ivec3(0), resolution - 1);
+}
+
+template <typename Func>
+void UniformGrid::forEachCell(int triangle, Func func) const {
+    const Triangle& tri = triangles[triangle];
+    AABB box = triangleBounds(tri);
+    glm::ivec3 first = cellOf(box.min);
+    glm::ivec3 last = cellOf(box.max);
+    if (first == last) {
+        func(cellIndex(first));
+        return;
+    }
+
+    // box 범위 안에서 삼각형 평면이 지나는 cell 만 (SAT 의 edge 축은 생략해 약간 보수적이다).
+    // cell 경계 평면에 놓인 면이 반올림 때문에 어느 cell 에도 들어가지 않는 일이 없도록
+    // cell 을 크기의 1e-4 만큼 키워 검사하고, 거리는 꼭짓점 기준으로 재어 큰 좌표끼리 빼지 않는다
+    glm::vec3 normal = glm::cross(tri.vertices[1] - tri.vertices[0], tri.vertices[2] - tri.vertices[0]);
+    glm::vec3 origin = tri.vertices[0] - bounds.min;
+    float radius = glm::dot(glm::abs(normal), cellSize * (0.5f + 1e-4f));
+    glm::ivec3 cell;
+    for (cell.z = first.z; cell.z <= last.z; ++cell.z) {
+        for (cell.y = first.y; cell.y <= last.y; ++cell.y) {
+            for (cell.x = first.x; cell.x <= last.x; ++cell.x) {
+                glm::vec3 center = (glm::vec3(cell) + 0.5f) * cellSize;
+                if (std::fabs(glm::dot(normal, center - origin)) <= radius) {
+                    func(cellIndex(cell));
+                }
+            }
+        }
+    }
+}
+
+void UniformGrid::build(const std::vector<Triangle>& input, float density, int maxResolution) {
+    triangles = input;
+    offsets.clear();
+    cellTriangles.clear();
+    resolution = glm::ivec3(0);
+    if (triangles.empty()) return;
+
+    bounds = calculateAABB(triangles);
+    glm::vec3 size = bounds.max - bounds.min;
+    float maxExtent = std::max(std::max(size.x, size.y), size.z);
+    if (!(maxExtent > 0.0f)) maxExtent = 1.0f;
+    float cellsPerUnit = density * std::cbrt(static_cast<float>(triangles.size())) / maxExtent;
+    for (int axis = 0; axis < 3; ++axis) {
+        int cells = static_cast<int>(std::lround(size[axis] * cellsPerUnit));
+        resolution[axis] = std::min(std::max(cells, 1), std::max(maxResolution, 1));
+        // 두께가 0 인 축도 나눗셈이 되도록 cell 크기를 0 보다 크게 둔다
+        cellSize[axis] = size[axis] > 0.0f ? size[axis] / static_cast<float>(resolution[axis]) : 1.0f;
+    }
+    invCellSize = 1.0f / cellSize;
+
+    size_t cellCount = static_cast<size_t>(resolution.x) * resolution.y * resolution.z;
+    std::unique_ptr<std::atomic<uint32_t>[]> counts(new std::atomic<uint32_t>[cellCount]);
+    parallelFor(cellCount, 1 << 16, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; ++i) {
+            counts[i].store(0, std::memory_order_relaxed);
+        }
+    });
+
+    parallelFor(triangles.size(), 1024, [&](size_t begin, size_t end, unsigned) {
+        for (size_t t = begin; t < end; ++t) {
+            forEachCell(static_cast<int>(t), [&](size_t cell) {
+                counts[cell].fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+    });
+
+    // 시작 위치를 구하고 counts 는 채울 자리를 가리키는 cursor 로 다시 쓴다
+    offsets.resize(cellCount + 1);
+    uint32_t total = 0;
+    for (size_t i = 0; i < cellCount; ++i) {
+        offsets[i] = total;
+        total += counts[i].load(std::memory_order_relaxed);
+        counts[i].store(offsets[i], std::memory_order_relaxed);
+    }
+    offsets[cellCount] = total;
+
+    cellTriangles.resize(total);
+    parallelFor(triangles.size(), 1024, [&](size_t begin, size_t end, unsigned) {
+        for (size_t t = begin; t < end; ++t) {
+            forEachCell(static_cast<int>(t), [&](size_t cell) {
+                cellTriangles[counts[cell].fetch_add(1, std::memory_order_relaxed)] = static_cast<int>(t);
+            });
+        }
+    });
+}
+
+RayHit UniformGrid::raycast(const glm::vec3& origin, const glm::vec3& direction, float tMax) const {
+    RayHit hit;
+    hit.distance = tMax;
+    if (offsets.empty()) return hit;
+
+    glm::vec3 invDirection = 1.0f / direction;
+    float tEnter;
+    if (!intersectRayAABB(origin, invDirection, bounds, tMax, tEnter)) return hit;
+
+    glm::ivec3 cell = cellOf(origin + direction * tEnter);
+    glm::ivec3 step;
+    glm::vec3 nextT, deltaT;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (direction[axis] > 0.0f) {
+            step[axis] = 1;
+            nextT[axis] = (bounds.min[axis] + (cell[axis] + 1) * cellSize[axis] - origin[axis]) * invDirection[axis];
+            deltaT[axis] = cellSize[axis] * invDirection[axis];
+        }
+        else if (direction[axis] < 0.0f) {
+            step[axis] = -1;
+            nextT[axis] = (bounds.min[axis] + cell[axis] * cellSize[axis] - origin[axis]) * invDirection[axis];
+            deltaT[axis] = -cellSize[axis] * invDirection[axis];
+        }
+        else {
+            step[axis] = 0;
+            nextT[axis] = INFINITY;
+            deltaT[axis] = INFINITY;
+        }
+    }
+
+    for (;;) {
+        size_t index = cellIndex(cell);
+        for (uint32_t i = offsets[index]; i < offsets[index + 1]; ++i) {
+            int id = cellTriangles[i];
+            float t;
+            glm::vec2 barycentric;
+            if (intersectRayTriangle(origin, direction, triangles[id].vertices, t, barycentric) &&
+                t >= 0.0f && t <= hit.distance) {
+                hit.triangle = id;
+                hit.distance = t;
+                hit.barycentric = barycentric;
+            }
+        }
+
+        // 이 cell 을 나가기 전에 맞았으면 뒤의 cell 에는 더 가까운 교차가 없다
+        int axis = nextT.x < nextT.y ? (nextT.x < nextT.z ? 0 : 2) : (nextT.y < nextT.z ? 1 : 2);
+        float cellExit = nextT[axis];
+        if (hit.distance <= cellExit || cellExit > tMax) break;
+
+        cell[axis] += step[axis];
+        if (cell[axis] < 0 || cell[axis] >= resolution[axis]) break;
+        nextT[axis] += deltaT[axis];
+    }
+    return hit;
+}
+
+void UniformGrid::raycastBatch(const Ray* rays, size_t count, RayHit* hits) const {
+    parallelFor(count, 256, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; ++i) {
+            hits[i] = raycast(rays[i].origin, rays[i].direction, rays[i].tMax);
+        }
+    });
+}
+
+void UniformGrid::query(const AABB& box, std::vector<int>& result) const {
+    result.clear();
+    if (offsets.empty() || !checkAABBCollision(box, bounds)) return;
+
+    // 여러 cell 에 든 삼각형은 stamp 로 한 번만 넣는다
+    thread_local std::vector<uint32_t> marks;
+    thread_local uint32_t stamp = 0;
+    if (marks.size() < triangles.size()) {
+        marks.assign(triangles.size(), 0);
+        stamp = 0;
+    }
+    if (++stamp == 0) {
+        std::fill(marks.begin(), marks.end(), 0);
+        stamp = 1;
+    }
+
+    glm::ivec3 first = cellOf(box.min);
+    glm::ivec3 last = cellOf(box.max);
+    glm::ivec3 cell;
+    for (cell.z = first.z; cell.z <= last.z; ++cell.z) {
+        for (cell.y = first.y; cell.y <= last.y; ++cell.y) {
+            for (cell.x = first.x; cell.x <= last.x; ++cell.x) {
+                size_t index = cellIndex(cell);
+                for (uint32_t i = offsets[index]; i < offsets[index + 1]; ++i) {
+                    int id = cellTriangles[i];
+                    if (marks[id] == stamp) continue;
+                    marks[id] = stamp;
+                    if (checkAABBCollision(triangleBounds(triangles[id]), box)) {
+                        result.push_back(id);
+                    }
+                }
+            }
+        }
+    }
+}
+
+size_t UniformGrid::getMemoryUsage() const {
+    return triangles.capacity() * sizeof(Triangle) + offsets.capacity() * sizeof(uint32_t) +
+        cellTriangles.capacity() * sizeof(int);
+}
@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm/glm.hpp>
+#include "geometry.h"
+#include "raycast.h"
+
+// 삼각형을 균일 격자에 나눠 담는다. cell 마다 삼각형 번호를 이어 붙인 배열 하나와 시작 위치만 두며
+// 두 번의 병렬 pass (cell 별 개수 세기, 자리 채우기) 로 만든다 (counting sort). 매 프레임 다시 만드는
+// mesh 처럼 만드는 비용이 중요할 때 트리 대신 쓴다. 여러 cell 에 걸친 삼각형은 평면이 지나는 cell 에만 넣는다
+class UniformGrid {
+public:
+    // 축마다 cell 수는 density * cbrt(n) 을 가장 긴 축 기준으로 나눈 값 (maxResolution 이하)
+    void build(const std::vector<Triangle>& triangles, float density = 2.0f, int maxResolution = 256);
+
+    // 3D-DDA 로 광선이 지나는 cell 을 가까운 순서로 방문한다. RayHit::triangle 은 build 에 넘긴 번호
+    RayHit raycast(const glm::vec3& origin, const glm::vec3& direction, float tMax) const;
+    void raycastBatch(const Ray* rays, size_t count, RayHit* hits) const;
+
+    // box 와 겹치는 cell 의 삼각형 중 삼각형 box 가 box 와 겹치는 것 (중복 없이)
+    void query(const AABB& box, std::vector<int>& result) const;
+
+    const AABB& getBounds() const { return bounds; }
+    const glm::ivec3& getResolution() const { return resolution; }
+    size_t getCellCount() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    size_t getReferenceCount() const { return cellTriangles.size(); }
+    size_t getMemoryUsage() const;
+
+private:
+    glm::ivec3 cellOf(const glm::vec3& p) const;
+    size_t cellIndex(const glm::ivec3& cell) const {
+        return (static_cast<size_t>(cell.z) * resolution.y + cell.y) * resolution.x + cell.x;
+    }
+    template <typename Func>
+    void forEachCell(int triangle, Func func) const;
+
+    AABB bounds;
+    glm::ivec3 resolution = glm::ivec3(0);
+    glm::vec3 cellSize = glm::vec3(1.0f);
+    glm::vec3 invCellSize = glm::vec3(1.0f);
+    std::vector<Triangle> triangles;
+    std::vector<uint32_t> offsets;   // cell 수 + 1. cell i 의 삼각형은 [offsets[i], offsets[i + 1])
+    std::vector<int> cellTriangles;
+};
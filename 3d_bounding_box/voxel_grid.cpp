@@ -0,0 +1,226 @@
+﻿#include "voxel_grid.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include "aabb_simd.h"
+#include "parallel.h"
+
+const int VoxelBitGrid::brickSize;
+
+namespace {
+
+int floorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+glm::ivec3 floorDiv(const glm::ivec3& a, int b) {
+    return glm::ivec3(floorDiv(a.x, b), floorDiv(a.y, b), floorDiv(a.z, b));
+}
+
+glm::ivec3 toVoxel(const glm::vec3& p, float cellSize) {
+    return glm::ivec3(glm::floor(p / cellSize));
+}
+
+}
+
+void VoxelBitGrid::build(const std::vector<Triangle>& triangles, float cellSize, bool solid) {
+    this->cellSize = cellSize;
+    origin = glm::ivec3(0);
+    brickCount = glm::ivec3(0);
+    bricks.clear();
+    if (triangles.empty() || !(cellSize > 0.0f)) return;
+
+    // 가장자리에 빈 voxel 이 한 겹 이상 남도록 한 칸씩 넓힌 뒤 brick 경계에 맞춘다
+    AABB bounds = calculateAABB(triangles);
+    glm::ivec3 first = floorDiv(toVoxel(bounds.min, cellSize) - 1, brickSize);
+    glm::ivec3 last = floorDiv(toVoxel(bounds.max, cellSize) + 1, brickSize);
+    origin = first * brickSize;
+    brickCount = last - first + 1;
+
+    size_t total = static_cast<size_t>(brickCount.x) * brickCount.y * brickCount.z;
+    std::vector<std::atomic<uint64_t>> words(total);
+    for (auto& word : words) {
+        word.store(0, std::memory_order_relaxed);
+    }
+
+    glm::ivec3 voxelMax = brickCount * brickSize - 1;
+    parallelFor(triangles.size(), 64, [&](size_t begin, size_t end, unsigned) {
+        for (size_t t = begin; t < end; ++t) {
+            const glm::vec3* v = triangles[t].vertices;
+            glm::ivec3 lo = glm::clamp(toVoxel(glm::min(glm::min(v[0], v[1]), v[2]), cellSize) - origin, glm::ivec3(0), voxelMax);
+            glm::ivec3 hi = glm::clamp(toVoxel(glm::max(glm::max(v[0], v[1]), v[2]), cellSize) - origin, glm::ivec3(0), voxelMax);
+
+            // brick 단위로 먼저 걸러내고 brick 하나의 bit 를 모아 한 번에 OR 한다
+            glm::ivec3 brick;
+            for (brick.z = lo.z / brickSize; brick.z <= hi.z / brickSize; ++brick.z) {
+                for (brick.y = lo.y / brickSize; brick.y <= hi.y / brickSize; ++brick.y) {
+                    for (brick.x = lo.x / brickSize; brick.x <= hi.x / brickSize; ++brick.x) {
+                        glm::ivec3 brickMin = brick * brickSize;
+                        AABB brickBox;
+                        brickBox.min = glm::vec3(origin + brickMin) * cellSize;
+                        brickBox.max = glm::vec3(origin + brickMin + brickSize) * cellSize;
+                        if (!checkTriangleAABBCollision(v, brickBox)) continue;
+
+                        glm::ivec3 from = glm::max(lo, brickMin);
+                        glm::ivec3 to = glm::min(hi, brickMin + brickSize - 1);
+                        uint64_t mask = 0;
+                        for (int z = from.z; z <= to.z; ++z) {
+                            for (int y = from.y; y <= to.y; ++y) {
+                                for (int x = from.x; x <= to.x; ++x) {
+                                    AABB cell;
+                                    cell.min = glm::vec3(origin + glm::ivec3(x, y, z)) * cellSize;
+                                    cell.max = cell.min + glm::vec3(cellSize);
+                                    if (checkTriangleAABBCollision(v, cell)) {
+                                        mask |= 1ull << bitIndex(x, y, z);
+                                    }
+                                }
+                            }
+                        }
+                        if (mask) {
+                            words[brickIndex(brick)].fetch_or(mask, std::memory_order_relaxed);
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    bricks.resize(total);
+    for (size_t i = 0; i < total; ++i) {
+        bricks[i] = words[i].load(std::memory_order_relaxed);
+    }
+
+    if (solid) {
+        fillInterior();
+    }
+}
+
+void VoxelBitGrid::fillInterior() {
+    // 가장자리 한 겹은 비어 있으므로 (0, 0, 0) 에서 표면을 지나지 않고 닿는 voxel 이 바깥이다.
+    // 표면이 없는 brick 은 한 voxel 만 닿아도 전체가 바깥이므로 brick 단위로 건너간다
+    struct FillItem {
+        glm::ivec3 position;
+        bool brick;
+    };
+
+    glm::ivec3 size = brickCount * brickSize;
+    std::vector<uint64_t> outside(bricks.size(), 0);
+    std::vector<FillItem> stack;
+    auto visit = [&](const glm::ivec3& voxel) {
+        glm::ivec3 brick = voxel / brickSize;
+        size_t word = brickIndex(brick);
+        if (bricks[word] == 0) {
+            if (outside[word] == 0) {
+                outside[word] = ~0ull;
+                stack.push_back({ brick, true });
+            }
+            return;
+        }
+
+        uint64_t bit = 1ull << bitIndex(voxel.x, voxel.y, voxel.z);
+        if ((bricks[word] | outside[word]) & bit) return;
+        outside[word] |= bit;
+        stack.push_back({ voxel, false });
+    };
+
+    visit(glm::ivec3(0));
+    while (!stack.empty()) {
+        FillItem item = stack.back();
+        stack.pop_back();
+
+        for (int axis = 0; axis < 3; ++axis) {
+            int u = (axis + 1) % 3;
+            int v = (axis + 2) % 3;
+            for (int step = -1; step <= 1; step += 2) {
+                if (!item.brick) {
+                    glm::ivec3 next = item.position;
+                    next[axis] += step;
+                    if (next[axis] >= 0 && next[axis] < size[axis]) {
+                        visit(next);
+                    }
+                    continue;
+                }
+
+                // 이웃 brick 에서 맞닿은 면의 voxel 16개
+                glm::ivec3 face = item.position * brickSize;
+                face[axis] = step < 0 ? face[axis] - 1 : face[axis] + brickSize;
+                if (face[axis] < 0 || face[axis] >= size[axis]) continue;
+                for (int i = 0; i < brickSize * brickSize; ++i) {
+                    glm::ivec3 next = face;
+                    next[u] += i % brickSize;
+                    next[v] += i / brickSize;
+                    visit(next);
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < bricks.size(); ++i) {
+        bricks[i] = ~outside[i];
+    }
+}
+
+bool VoxelBitGrid::get(const glm::ivec3& voxel) const {
+    if (glm::any(glm::lessThan(voxel, glm::ivec3(0))) ||
+        glm::any(glm::greaterThanEqual(voxel, brickCount * brickSize))) {
+        return false;
+    }
+    return ((bricks[brickIndex(voxel / brickSize)] >> bitIndex(voxel.x, voxel.y, voxel.z)) & 1) != 0;
+}
+
+bool VoxelBitGrid::contains(const glm::vec3& point) const {
+    return get(toVoxel(point, cellSize) - origin);
+}
+
+size_t VoxelBitGrid::countVoxels() const {
+    size_t count = 0;
+    for (uint64_t word : bricks) {
+        count += countBits(word);
+    }
+    return count;
+}
+
+// 겹치는 brick 쌍마다 func(a & b). func 가 false 를 돌려주면 멈추고 false 를 반환한다
+template <typename Func>
+bool VoxelBitGrid::forEachOverlap(const VoxelBitGrid& other, Func func) const {
+    if (cellSize != other.cellSize || bricks.empty() || other.bricks.empty()) return true;
+
+    glm::ivec3 firstA = origin / brickSize;
+    glm::ivec3 firstB = other.origin / brickSize;
+    glm::ivec3 first = glm::max(firstA, firstB);
+    glm::ivec3 last = glm::min(firstA + brickCount, firstB + other.brickCount) - 1;
+
+    glm::ivec3 brick;
+    for (brick.z = first.z; brick.z <= last.z; ++brick.z) {
+        for (brick.y = first.y; brick.y <= last.y; ++brick.y) {
+            size_t rowA = brickIndex(glm::ivec3(first.x, brick.y, brick.z) - firstA);
+            size_t rowB = other.brickIndex(glm::ivec3(first.x, brick.y, brick.z) - firstB);
+            for (int x = 0; x <= last.x - first.x; ++x) {
+                uint64_t word = bricks[rowA + x] & other.bricks[rowB + x];
+                if (word && !func(word)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool VoxelBitGrid::overlaps(const VoxelBitGrid& other) const {
+    return !forEachOverlap(other, [](uint64_t) { return false; });
+}
+
+size_t VoxelBitGrid::countOverlap(const VoxelBitGrid& other) const {
+    size_t count = 0;
+    forEachOverlap(other, [&](uint64_t word) {
+        count += countBits(word);
+        return true;
+    });
+    return count;
+}
+
+AABB VoxelBitGrid::getBounds() const {
+    AABB box;
+    box.min = glm::vec3(origin) * cellSize;
+    box.max = glm::vec3(origin + brickCount * brickSize) * cellSize;
+    return box;
+}
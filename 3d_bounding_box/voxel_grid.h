@@ -0,0 +1,50 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm/glm.hpp>
+#include "geometry.h"
+
+// voxel 하나를 bit 하나로 저장하는 격자. 4x4x4 brick 이 uint64 하나이고 brick 안의 bit 순서는
+// splitAABB 의 자식 번호(bit 0 = x, 1 = y, 2 = z)를 두 번 적용한 Z-order 이다.
+// 격자 원점은 월드 좌표의 brick 경계에 맞추므로 cellSize 가 같은 두 격자는 word 단위로 바로 겹쳐 볼 수 있다
+class VoxelBitGrid {
+public:
+    static const int brickSize = 4;
+
+    // 삼각형이 닿는 voxel 을 모두 켠다 (삼각형/box 분리 축 검사). 삼각형은 스레드에 나누고 brick 에 atomic OR 로 쓴다.
+    // solid 면 격자 가장자리에서 flood fill 로 닿지 않는 안쪽 voxel 도 채운다 (닫힌 mesh 일 때 의미가 있다)
+    void build(const std::vector<Triangle>& triangles, float cellSize, bool solid = true);
+
+    bool get(const glm::ivec3& voxel) const;
+    bool contains(const glm::vec3& point) const;
+    size_t countVoxels() const;
+
+    // 같은 cellSize 로 만든 두 격자의 겹치는 brick 을 AND 한다. cellSize 가 다르면 false, 0
+    bool overlaps(const VoxelBitGrid& other) const;
+    size_t countOverlap(const VoxelBitGrid& other) const;
+
+    AABB getBounds() const;
+    float getCellSize() const { return cellSize; }
+    const glm::ivec3& getBrickCount() const { return brickCount; }
+    const std::vector<uint64_t>& getBricks() const { return bricks; }
+
+    static int bitIndex(int x, int y, int z) {
+        return (x & 1) | ((y & 1) << 1) | ((z & 1) << 2) | ((x & 2) << 2) | ((y & 2) << 3) | ((z & 2) << 4);
+    }
+
+private:
+    size_t brickIndex(const glm::ivec3& brick) const {
+        return brick.x + static_cast<size_t>(brickCount.x) * (brick.y + static_cast<size_t>(brickCount.y) * brick.z);
+    }
+    void fillInterior();
+
+    template <typename Func>
+    bool forEachOverlap(const VoxelBitGrid& other, Func func) const;
+
+    float cellSize = 1.0f;
+    glm::ivec3 origin = glm::ivec3(0);  // 첫 voxel 의 월드 격자 좌표 (brickSize 의 배수)
+    glm::ivec3 brickCount = glm::ivec3(0);
+    std::vector<uint64_t> bricks;
+};